@@ -9,6 +9,18 @@
 
 //--Includes-------------------------------------------------------------------
 #include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 //--Consts, enums and lists----------------------------------------------------
 const int InputsPerGate = 2;                                                // Number of inputs per nand gate
@@ -26,6 +38,42 @@ enum eLogicLevel                                                            // E
   LOGIC_HIGH
 };
 
+enum eGateType                                                              // Gate types known to the netlist simulator
+{
+  GATE_NAND,
+  GATE_AND,
+  GATE_OR,
+  GATE_XOR,
+  NUM_GATE_TYPES
+};
+
+enum eResultFormat                                                          // How CResultWriter prints each result
+{
+  FORMAT_BINARY,
+  FORMAT_HEX,
+  FORMAT_RAW
+};
+
+// Propagation delay of each gate type in picoseconds, indexed by eGateType.
+// AND and OR are a NAND/NOR plus an inverter, XOR is the slowest of the set.
+const int GateDelays[NUM_GATE_TYPES] = { 10, 20, 20, 30 };
+const char* const GateNames[NUM_GATE_TYPES] = { "NAND", "AND", "OR", "XOR" };
+const int DefaultTimingBits = 20000;                                        // 20000-bit ripple adder is ~100k gates
+const int MaxReportedPathSteps = 12;                                        // Critical path steps printed before eliding
+const int DefaultEquivalenceBits = 64;                                      // Adder width for the equivalence check
+const int MaxBddNodes = 1 << 22;                                            // BDD nodes before the equivalence check gives up
+const int InitialBddTableSize = 1 << 12;                                    // Starting unique table size, doubled as nodes are added
+const int LanesPerWord = 64;                                                // Test vectors simulated per pass of the lane simulator
+const int MaxStressBits = 63;                                               // Widest adder whose sum fits the 64-bit reference
+const int DefaultStressBits = 32;
+const long DefaultStressVectors = 100000000;
+const uint64_t DefaultStressSeed = 2024;
+const size_t DefaultResultBufferSize = 1 << 20;                             // Bytes CResultWriter buffers between writes
+const int BenchmarkBits = 32;                                               // Adder width for the output benchmark
+const long DefaultBenchmarkResults = 10000000;
+const int DefaultHierarchyBits = 1024;
+const int HierarchyCheckPasses = 1000;                                      // Lane simulator passes comparing flattened and flat adders
+
 //---Forward Declarations------------------------------------------------------
 class CGate;                                                                    // Forward declaration 
 
@@ -139,6 +187,44 @@ class CFullAdder: public CHalfAdder
         CORGate MyOrGates[NumOrGates];                                              // OR gates required for a full adder
 };
 
+//---CResultWriter Interface---------------------------------------------------
+// Buffered output stage for adder results.
+// Results are formatted straight into one preallocated buffer, which is only
+// written out when full or on Flush, so bulk runs make a handful of large
+// writes instead of one flushed line per result.
+class CResultWriter
+{
+    public:
+        CResultWriter( FILE* apFile, eResultFormat aFormat, size_t aBufferSize = DefaultResultBufferSize );
+        ~CResultWriter();
+
+        // Reads "binary", "hex" or "raw" into aFormat, false if it is none of them
+        static bool ParseFormat( const char* aName, eResultFormat& aFormat );
+
+        // Writes aNumBits levels, most significant first, undefined levels as X in binary
+        void WriteResult( const eLogicLevel* aBits, int aNumBits );
+
+        // Writes the low aNumBits of aValue
+        void WriteResult( uint64_t aValue, int aNumBits );
+
+        // Copies text into the buffer as is
+        void WriteText( const char* aText );
+
+        eResultFormat GetFormat() const;
+
+        // Writes out everything buffered so far
+        void Flush();
+
+    private:
+        // Flushes if fewer than aBytes are free
+        void Reserve( size_t aBytes );
+
+        FILE* mpFile;
+        eResultFormat mFormat;
+        std::vector<char> mBuffer;
+        size_t mUsed;                                                       // Bytes of mBuffer holding pending output
+};
+
 //---ParallelAdder Interface-------------------------------------------------
 // Takes inputs from the user and does binary parallel addition using 1 parallel adder
 // Made up of 1 half adder and 2 full adders --> 5 half adders
@@ -157,8 +243,379 @@ class CParallelAdder: public CHalfAdder
         // Get user input
         int ObtainInput(eLogicLevel FirstNumber[MaxBinaryInput],eLogicLevel SecondNumber[MaxBinaryInput] );                 
 
-        // Output of the Parallel Adder
-        void ParallelAdderOutput(eLogicLevel FirstNumber[MaxBinaryInput], eLogicLevel SecondNumber[MaxBinaryInput]);
+        // Output of the Parallel Adder, written through aWriter in its format
+        void ParallelAdderOutput(eLogicLevel FirstNumber[MaxBinaryInput], eLogicLevel SecondNumber[MaxBinaryInput], CResultWriter& aWriter);
+};
+
+//---CNetlist Interface--------------------------------------------------------
+// Flat gate-level description of a circuit used by the timing tools.
+// Unlike CGate/CWire, which push values through immediately, a netlist is
+// just data: every gate has a type, two input nets and one output net.
+// A gate can only be added once its input nets exist, so mGates is always
+// in topological order and can be swept front to back.
+class CNetlist
+{
+    public:
+        struct Gate
+        {
+            eGateType Type;
+            int Inputs[InputsPerGate];                                      // Nets read by the gate
+            int Output;                                                     // Net driven by the gate
+        };
+
+        // Adds a primary input and returns its net
+        int AddInput( const std::string& aName );
+
+        // Adds a gate reading two existing nets and returns the net it drives
+        int AddGate( eGateType aType, int aInputNetA, int aInputNetB );
+
+        // Marks a net as a primary output of the circuit
+        void AddOutput( int aNet, const std::string& aName );
+
+        // Same structure as CHalfAdder and CFullAdder, built from netlist gates
+        void AddHalfAdder( int aInputA, int aInputB, int& aSum, int& aCarry );
+        void AddFullAdder( int aCarryIn, int aInputA, int aInputB, int& aSum, int& aCarry );
+
+        // N-bit version of CParallelAdder: a half adder for the LSB and a chain
+        // of full adders. Inputs are interleaved A0, B0, A1, B1 ... and outputs
+        // are S0 .. S(N-1) followed by the carry out.
+        void BuildRippleAdder( int aBits );
+
+        // Kogge-Stone parallel prefix adder with the same inputs and outputs as
+        // BuildRippleAdder, carries are computed in log2(N) levels
+        void BuildPrefixAdder( int aBits );
+
+        // Joins two netlists with matching inputs and outputs into one whose single
+        // output is high whenever any pair of their outputs differ
+        void BuildMiter( const CNetlist& aFirst, const CNetlist& aSecond );
+
+        // Builds the net -> reading gates table once the circuit is complete
+        void BuildFanout();
+
+        // Copies aOther's gates in, reading aInputNets for its inputs, and returns its output nets
+        std::vector<int> AddCopyOf( const CNetlist& aOther, const std::vector<int>& aInputNets );
+
+        int GetNumNets() const;
+
+        // Bytes held by the gates, nets, names and fanout table
+        size_t GetMemoryBytes() const;
+
+        // Same logic as the CGate ComputeOutput functions, undefined in gives undefined out
+        static eLogicLevel EvaluateGate( eGateType aType, eLogicLevel aInputA, eLogicLevel aInputB );
+
+        std::vector<Gate> mGates;                                           // Gates in topological order
+        std::vector<int> mInputNets;                                        // Primary input nets
+        std::vector<std::string> mInputNames;
+        std::vector<int> mOutputNets;                                       // Primary output nets
+        std::vector<std::string> mOutputNames;
+        std::vector<int> mDriver;                                           // Gate driving each net, -1 for a primary input
+        std::vector<int> mFanoutStart;                                      // Offset of each net's readers in mFanoutGates
+        std::vector<int> mFanoutGates;                                      // Gates reading each net, grouped by net
+};
+
+//---CTimingWheel Interface----------------------------------------------------
+// Event queue for the delay simulation.
+// Every event is scheduled at most the largest gate delay ahead of the current
+// time, so a circular array of time slots larger than that delay never wraps
+// onto itself. Scheduling and popping are O(1), with no priority queue.
+class CTimingWheel
+{
+    public:
+        struct Event
+        {
+            int Net;
+            eLogicLevel Level;
+        };
+
+        CTimingWheel( int aMaxDelay );
+
+        // Queues a net change at aTime, which must be within the max delay of now
+        void Schedule( long aTime, int aNet, eLogicLevel aLevel );
+
+        // Moves the next non-empty slot into aEvents, returns false when empty
+        bool PopNextSlot( long& aTime, std::vector<Event>& aEvents );
+
+        long GetCurrentTime() const;
+
+    private:
+        std::vector< std::vector<Event> > mSlots;                          // One bucket per time step, indexed by time & mSlotMask
+        long mSlotMask;
+        long mCurrentTime;
+        long mNumPending;                                                   // Events not yet popped
+};
+
+//---CTimingSimulator Interface------------------------------------------------
+// Event-driven simulation of a CNetlist with per-gate-type delays.
+// Each time slot applies its net changes first and then evaluates every
+// affected gate once, scheduling its output GateDelays[Type] later.
+class CTimingSimulator
+{
+    public:
+        CTimingSimulator( const CNetlist& aNetlist );
+
+        // Changes a primary input at the current simulation time
+        void DriveInput( int aInputIndex, eLogicLevel aLevel );
+
+        // Runs until no events are left and returns the time of the last change
+        long Run();
+
+        eLogicLevel GetNetLevel( int aNet ) const;
+        long GetLastChangeTime( int aNet ) const;
+        long GetEventsProcessed() const;
+
+    private:
+        const CNetlist& mNetlist;
+        CTimingWheel mWheel;
+        std::vector<eLogicLevel> mLevels;                                   // Current level of each net
+        std::vector<eLogicLevel> mProjected;                                // Level each net will have once queued events land
+        std::vector<long> mLastChange;                                      // Time each net last changed
+        std::vector<long> mGateStamp;                                       // Slot a gate was last queued for evaluation in
+        long mSlotsRun;                                                     // Counts every slot, a time can come round again in a later Run()
+        std::vector<int> mGatesToEvaluate;
+        std::vector<CTimingWheel::Event> mSlotEvents;
+        long mEventsProcessed;
+        long mSettleTime;
+};
+
+//---CStaticTiming Interface---------------------------------------------------
+// Static timing analysis: the arrival time of every net assuming all inputs
+// switch at time 0, and the chain of gates that sets the worst output.
+class CStaticTiming
+{
+    public:
+        // Computes arrival times and returns the worst output arrival
+        long Analyse( const CNetlist& aNetlist );
+
+        // Prints the critical path found by Analyse, eliding the middle of long paths
+        void ReportCriticalPath( const CNetlist& aNetlist );
+
+    private:
+        std::vector<long> mArrival;                                         // Arrival time of each net
+        std::vector<int> mCriticalInput;                                    // Latest arriving input net of each net's driver
+        int mWorstOutput;                                                   // Output net with the latest arrival
+};
+
+//---CBddManager Interface-----------------------------------------------------
+// Reduced ordered binary decision diagrams over the primary inputs of a netlist.
+// Nodes are hash-consed through a unique table, so two functions are equal
+// exactly when they are the same node. Variable order is the input order, which
+// for the adders is interleaved A0, B0, A1, B1 ... and keeps adder BDDs linear.
+class CBddManager
+{
+    public:
+        CBddManager( int aNumVars, int aNodeLimit );
+
+        static const int False = 0;
+        static const int True = 1;
+
+        // The function that is just input aVar
+        int Variable( int aVar );
+
+        // Combines two functions with a gate's logic, returns -1 past the node limit
+        int Apply( eGateType aOp, int aF, int aG );
+
+        // Fills aAssignment with an input vector making aF true, aF must not be False
+        void FindSatisfying( int aF, std::vector<eLogicLevel>& aAssignment );
+
+        int GetNumNodes() const;
+
+    private:
+        struct Node
+        {
+            int Var;                                                        // Input tested by the node, mNumVars for terminals
+            int Low;                                                        // Node when the input is low
+            int High;                                                       // Node when the input is high
+        };
+
+        struct CacheEntry
+        {
+            int Op, F, G, Result;
+        };
+
+        int MakeNode( int aVar, int aLow, int aHigh );
+        size_t FindSlot( int aVar, int aLow, int aHigh ) const;
+        void Resize( int aTableSize );
+        int ApplyTerminal( eGateType aOp, int aF, int aG );
+
+        int mNumVars;
+        int mNodeLimit;
+        std::vector<Node> mNodes;
+        std::vector<int> mUniqueTable;                                      // Open addressing on (Var, Low, High), -1 if empty
+        std::vector<CacheEntry> mComputedCache;                             // Direct mapped Apply results, may be overwritten
+};
+
+//---CEquivalenceChecker Interface---------------------------------------------
+// Proves two netlists compute the same outputs for every input vector.
+// Both circuits are joined into a miter: shared inputs, each pair of outputs
+// XORed and all the XORs ORed into one "differ" output. The circuits are
+// equivalent exactly when the miter output's BDD is constant low.
+class CEquivalenceChecker
+{
+    public:
+        // Returns true if equivalent, otherwise fills the counterexample when one exists
+        bool Check( const CNetlist& aFirst, const CNetlist& aSecond );
+
+        // Input vector for which the circuits differ, empty if none was found
+        std::vector<eLogicLevel> mCounterexample;
+        int mBddNodes;                                                      // Nodes used by the last check
+};
+
+//---CXoshiro256 Interface-----------------------------------------------------
+// xoshiro256** random number generator, seeded through splitmix64.
+// Much faster than rand() and with no shared state, so each thread owns one.
+class CXoshiro256
+{
+    public:
+        CXoshiro256( uint64_t aSeed );
+
+        uint64_t Next();
+
+        // Advances the generator 2^128 steps, giving non-overlapping streams
+        void Jump();
+
+    private:
+        uint64_t mState[4];
+};
+
+//---CLaneSimulator Interface--------------------------------------------------
+// Bit-parallel evaluation of a CNetlist: every net holds a 64-bit word with
+// one bit per test vector, so one sweep of the gates simulates 64 vectors.
+// Undefined levels are not modelled, every lane is either low or high.
+class CLaneSimulator
+{
+    public:
+        CLaneSimulator( const CNetlist& aNetlist );
+
+        // aInputWords[i] holds input i for all 64 lanes, aOutputWords likewise for outputs
+        void Evaluate( const uint64_t* aInputWords, uint64_t* aOutputWords );
+
+    private:
+        const CNetlist& mNetlist;
+        std::vector<uint64_t> mNetWords;                                    // Current word of each net
+};
+
+//---CStressTester Interface---------------------------------------------------
+// Random-vector testing of a two operand circuit against a native reference.
+// The circuit must be laid out like BuildRippleAdder: inputs A0, B0, A1, B1 ...
+// and outputs read as one little-endian number. Random words go straight into
+// the packed input lanes and are transposed back into integers for checking.
+class CStressTester
+{
+    public:
+        typedef uint64_t (*ReferenceFunction)( uint64_t aFirst, uint64_t aSecond );
+
+        CStressTester( const CNetlist& aCircuit, int aBits, ReferenceFunction aReference );
+
+        // Runs aVectors (rounded up to whole passes) over aThreads threads, true if all matched.
+        // Thread t uses aSeed's generator jumped t times, so a seed and thread count reproduce a run.
+        bool Run( uint64_t aSeed, long aVectors, int aThreads );
+
+        long mVectorsRun;
+        double mSeconds;
+
+        // First mismatch found, valid when Run returns false
+        uint64_t mFailFirst, mFailSecond, mFailExpected, mFailActual;
+
+    private:
+        void Worker( int aThread, uint64_t aSeed, long aPasses );
+
+        // Transposes a 64x64 bit matrix: bit l of word i moves to bit i of word l
+        static void Transpose64( uint64_t aWords[64] );
+
+        const CNetlist& mCircuit;
+        int mBits;
+        ReferenceFunction mReference;
+        uint64_t mOutputMask;                                               // Low bits covered by the circuit's outputs
+        std::atomic<bool> mFailed;
+        std::atomic<long> mPassesRun;                                       // Passes completed across all threads
+        std::mutex mFailLock;
+};
+
+//---CModuleDef Interface------------------------------------------------------
+// One module definition (half adder, full adder ...), stored once however many
+// times it is instanced. Nets are local to the definition: the inputs are nets
+// 0 .. NumInputs-1 and every gate or instance output is the next net after
+// them, so output nets are implied by the order and never stored.
+// An item is its kind followed by the nets it reads, each written as how far
+// it lies behind the next new net in a code of 7 bits per byte. A carry just
+// made is one byte back, so a full adder instance costs about six bytes.
+// Port names are patterns. A name ending in '#' is a bus of mBusWidth ports
+// numbered from 0, and bus names next to each other are interleaved bit by
+// bit, so "A#", "B#" names the ports A0, B0, A1, B1 ...
+class CModuleDef
+{
+    public:
+        std::string mName;
+        int mNumInputs;
+        int mNumOutputs;
+        int mNumNets;
+        int mBusWidth;
+        int mLastOutputNet;                                                 // Output nets are stored as steps from this one
+        std::string mInputNames;                                            // Name patterns back to back, each ended by '\0'
+        std::string mOutputNames;
+        std::vector<uint8_t> mItems;                                        // Gates and instances in topological order
+        std::vector<uint8_t> mOutputNets;                                   // Steps between output nets, sign in the low bit
+};
+
+//---CDesign Interface---------------------------------------------------------
+// Hierarchical circuit built from shared module definitions.
+// A 1024-bit adder is one full adder definition plus 1023 instances of a few
+// bytes each, rather than 1023 copies of the gates and wires. Simulation and
+// the other tools work on a CNetlist, flattened the first time it is asked for.
+class CDesign
+{
+    public:
+        CDesign();
+
+        // Adds an empty definition and returns its index. The names are
+        // patterns as described at CModuleDef, aBusWidth the width of any bus.
+        int AddDefinition( const std::string& aName, const std::vector<std::string>& aInputNames,
+                           const std::vector<std::string>& aOutputNames, int aBusWidth = 0 );
+
+        // Adds a gate to aDefinition reading two local nets, returns its output net
+        int AddGate( int aDefinition, eGateType aType, int aInputA, int aInputB );
+
+        // Instances aSubDefinition inside aDefinition, aOutputs gets the new local output nets
+        void AddInstance( int aDefinition, int aSubDefinition, const std::vector<int>& aInputs, std::vector<int>& aOutputs );
+
+        // Connects aDefinition's next output port to a local net
+        void AddOutput( int aDefinition, int aNet );
+
+        // The definition flattened by GetFlattened
+        void SetTop( int aDefinition );
+
+        // Half adder and full adder definitions instanced into an N-bit ripple adder,
+        // with the same inputs and outputs as CNetlist::BuildRippleAdder
+        void BuildRippleAdder( int aBits );
+
+        // Releases spare vector capacity once the design is built
+        void Compact();
+
+        // Gate-level netlist of the top definition, flattened on the first call
+        // and kept until the design changes or ReleaseFlattened frees it
+        const CNetlist& GetFlattened();
+        void ReleaseFlattened();
+
+        // Bytes held by the definitions, and the part of that spent on port names.
+        // A flattened netlist that is being kept is not included.
+        size_t GetMemoryBytes() const;
+        size_t GetPortNameBytes() const;
+
+    private:
+        // Adds aDefinition's gates to aFlat reading aInputs, fills aOutputs
+        void FlattenDefinition( int aDefinition, const std::vector<int>& aInputs, std::vector<int>& aOutputs,
+                                CNetlist& aFlat ) const;
+
+        // Every port name the patterns stand for, in port order
+        static void ExpandPortNames( const std::string& aPatterns, int aBusWidth, std::vector<std::string>& aNames );
+
+        static void AppendCode( std::vector<uint8_t>& aCode, unsigned aValue );
+        static unsigned ReadCode( const uint8_t*& apCode );
+
+        std::vector<CModuleDef> mDefinitions;
+        int mTop;
+        CNetlist mFlattened;
+        bool mFlattenedValid;
 };
 
 //---CTestParallelAdder Interface---------------------------------------------
@@ -166,14 +623,82 @@ class CParallelAdder: public CHalfAdder
 class CTestParallelAdder
 {
     public:
-         void Test();
+         void Test( eResultFormat aFormat );
+
+         // Static timing and delay simulation of an aBits-wide ripple adder,
+         // false if the simulator gets a small chain of gates wrong
+         bool TestTiming( int aBits );
+
+         // Proves the ripple and prefix adders equivalent, then shows a counterexample for a broken one,
+         // false if either answer is wrong
+         bool TestEquivalence( int aBits );
+
+         // Random-vector stress test of the ripple and prefix adders against native addition,
+         // false if either adder fails
+         bool TestStress( int aBits, long aVectors, uint64_t aSeed, int aThreads );
+
+         // Results per second of the buffered writer to stdout and to a file, against iostream with endl
+         void TestOutputBenchmark( eResultFormat aFormat, long aResults, const char* aFileName );
+
+         // Memory of the hierarchical adder against CFullAdder objects, checked against the flat netlist,
+         // false if the flattened design does not match it
+         bool TestHierarchy( int aBits );
 };
 
 //---main----------------------------------------------------------------------
-int main()
+int main( int argc, char* argv[] )
 {   
     CTestParallelAdder TestCase;
-    TestCase.Test();
+
+    // "timing [bits]" runs the timing analysis, "equiv [bits]" the equivalence
+    // check, "stress [bits] [vectors] [seed] [threads]" the random-vector test,
+    // "bench [format] [results] [file]" the output benchmark, "hier [bits]" the
+    // hierarchical adder, otherwise the interactive adder with an optional
+    // output format
+    if( argc > 1 && strcmp( argv[1], "timing" ) == 0 )
+    {
+        return TestCase.TestTiming( argc > 2 ? atoi( argv[2] ) : DefaultTimingBits ) ? 0 : 1;
+    }
+
+    if( argc > 1 && strcmp( argv[1], "equiv" ) == 0 )
+    {
+        return TestCase.TestEquivalence( argc > 2 ? atoi( argv[2] ) : DefaultEquivalenceBits ) ? 0 : 1;
+    }
+
+    if( argc > 1 && strcmp( argv[1], "stress" ) == 0 )
+    {
+        bool Passed = TestCase.TestStress( argc > 2 ? atoi( argv[2] ) : DefaultStressBits,
+                                           argc > 3 ? atol( argv[3] ) : DefaultStressVectors,
+                                           argc > 4 ? strtoull( argv[4], NULL, 10 ) : DefaultStressSeed,
+                                           argc > 5 ? atoi( argv[5] ) : (int)std::thread::hardware_concurrency() );
+        return Passed ? 0 : 1;
+    }
+
+    if( argc > 1 && strcmp( argv[1], "hier" ) == 0 )
+    {
+        return TestCase.TestHierarchy( argc > 2 ? atoi( argv[2] ) : DefaultHierarchyBits ) ? 0 : 1;
+    }
+
+    eResultFormat Format = FORMAT_BINARY;
+    if( argc > 1 && strcmp( argv[1], "bench" ) == 0 )
+    {
+        if( argc > 2 && !CResultWriter::ParseFormat( argv[2], Format ) )
+        {
+            std::cout << "The output format must be binary, hex or raw" << std::endl;
+            return 1;
+        }
+        TestCase.TestOutputBenchmark( Format, argc > 3 ? atol( argv[3] ) : DefaultBenchmarkResults,
+                                      argc > 4 ? argv[4] : "AdderResults.out" );
+        return 0;
+    }
+
+    if( argc > 1 && !CResultWriter::ParseFormat( argv[1], Format ) )
+    {
+        std::cout << "Unknown mode " << argv[1] << std::endl;
+        return 1;
+    }
+
+    TestCase.Test( Format );
 }
 
 //---CWire Implementation------------------------------------------------------
@@ -424,10 +949,12 @@ int CParallelAdder::ObtainInput(eLogicLevel FirstNumber[MaxBinaryInput], eLogicL
             return 0;
         }
     }
+
+    return 1;
 }
 
 // Taking both logic lists from the user and computing the output
-void CParallelAdder::ParallelAdderOutput(eLogicLevel FirstNumber[MaxBinaryInput], eLogicLevel SecondNumber[MaxBinaryInput])
+void CParallelAdder::ParallelAdderOutput(eLogicLevel FirstNumber[MaxBinaryInput], eLogicLevel SecondNumber[MaxBinaryInput], CResultWriter& aWriter)
 {
     // Instantiate 1 half adder and 2 full adders
     CHalfAdder HalfAdder1s;
@@ -453,18 +980,25 @@ void CParallelAdder::ParallelAdderOutput(eLogicLevel FirstNumber[MaxBinaryInput]
     // Taking the 4s full adder output from the fulladder2s carry and the MSB of both inputs
     FullAdder4sOutput = FullAdder4s.FullAdderOutput(FullAdder2sOutput.Carry, A2, B2);
 
-    // User display of the results
-    std::cout << " " << FirstInputNumber[0] << FirstInputNumber[1] << FirstInputNumber[2] << std::endl;
-    std::cout << " " << SecondInputNumber[0] << SecondInputNumber[1] << SecondInputNumber[2] << " +" << std::endl;
-
-    std::cout << "------\n";
+    // User display of the results, laid out as a sum in binary
+    if( aWriter.GetFormat() == FORMAT_BINARY )
+    {
+        char Operands[] = " 000\n 000 +\n------\n";
+        for( int i = 0; i < MaxBinaryInput; i++ )
+        {
+            Operands[1 + i] = FirstInputNumber[i];
+            Operands[6 + i] = SecondInputNumber[i];
+        }
+        aWriter.WriteText( Operands );
+    }
 
-    // Printing all of the sums and the final carry bit
-    std::cout << FullAdder4sOutput.Carry << FullAdder4sOutput.Sum <<  FullAdder2sOutput.Sum << HalfAdder1sOutput.Sum << std::endl;
+    // Writing all of the sums and the final carry bit
+    eLogicLevel Result[MaxBinaryInput + 1] = { FullAdder4sOutput.Carry, FullAdder4sOutput.Sum, FullAdder2sOutput.Sum, HalfAdder1sOutput.Sum };
+    aWriter.WriteResult( Result, MaxBinaryInput + 1 );
 }
 
 // Test class to simplify main
-void CTestParallelAdder::Test()
+void CTestParallelAdder::Test( eResultFormat aFormat )
 {
     // 3-bit Flag   
     int Flag = 1;
@@ -489,5 +1023,1562 @@ void CTestParallelAdder::Test()
     }
 
     // Compute output
-    ParallelAdder.ParallelAdderOutput(FirstNumber, SecondNumber);
-}
\ No newline at end of file
+    CResultWriter Writer( stdout, aFormat );
+    ParallelAdder.ParallelAdderOutput(FirstNumber, SecondNumber, Writer);
+}
+
+//---CNetlist Implementation---------------------------------------------------
+// Primary inputs have no driving gate
+int CNetlist::AddInput( const std::string& aName )
+{
+    int Net = GetNumNets();
+    mDriver.push_back( -1 );
+    mInputNets.push_back( Net );
+    mInputNames.push_back( aName );
+    return Net;
+}
+
+// Each gate drives a fresh net
+int CNetlist::AddGate( eGateType aType, int aInputNetA, int aInputNetB )
+{
+    Gate NewGate;
+    NewGate.Type = aType;
+    NewGate.Inputs[0] = aInputNetA;
+    NewGate.Inputs[1] = aInputNetB;
+    NewGate.Output = GetNumNets();
+
+    mDriver.push_back( (int)mGates.size() );
+    mGates.push_back( NewGate );
+    return NewGate.Output;
+}
+
+void CNetlist::AddOutput( int aNet, const std::string& aName )
+{
+    mOutputNets.push_back( aNet );
+    mOutputNames.push_back( aName );
+}
+
+// XOR is sum, AND is carry
+void CNetlist::AddHalfAdder( int aInputA, int aInputB, int& aSum, int& aCarry )
+{
+    aSum = AddGate( GATE_XOR, aInputA, aInputB );
+    aCarry = AddGate( GATE_AND, aInputA, aInputB );
+}
+
+// Two half adders with their carries ORed, wired as in CFullAdder::FullAdderOutput
+void CNetlist::AddFullAdder( int aCarryIn, int aInputA, int aInputB, int& aSum, int& aCarry )
+{
+    int Sum1, Carry1, Carry2;
+    AddHalfAdder( aCarryIn, aInputA, Sum1, Carry1 );
+    AddHalfAdder( aInputB, Sum1, aSum, Carry2 );
+    aCarry = AddGate( GATE_OR, Carry1, Carry2 );
+}
+
+// Same chain as CParallelAdder::ParallelAdderOutput, for any number of bits
+void CNetlist::BuildRippleAdder( int aBits )
+{
+    std::vector<int> A( aBits ), B( aBits );
+    for( int i = 0; i < aBits; ++i )
+    {
+        A[i] = AddInput( "A" + std::to_string( i ) );
+        B[i] = AddInput( "B" + std::to_string( i ) );
+    }
+
+    int Sum, Carry;
+    AddHalfAdder( A[0], B[0], Sum, Carry );
+    AddOutput( Sum, "S0" );
+
+    for( int i = 1; i < aBits; ++i )
+    {
+        AddFullAdder( Carry, A[i], B[i], Sum, Carry );
+        AddOutput( Sum, "S" + std::to_string( i ) );
+    }
+    AddOutput( Carry, "Cout" );
+
+    BuildFanout();
+}
+
+// Generate and propagate pairs combined in a Kogge-Stone prefix tree
+void CNetlist::BuildPrefixAdder( int aBits )
+{
+    std::vector<int> A( aBits ), B( aBits );
+    for( int i = 0; i < aBits; ++i )
+    {
+        A[i] = AddInput( "A" + std::to_string( i ) );
+        B[i] = AddInput( "B" + std::to_string( i ) );
+    }
+
+    std::vector<int> Propagate( aBits ), Generate( aBits );
+    for( int i = 0; i < aBits; ++i )
+    {
+        Propagate[i] = AddGate( GATE_XOR, A[i], B[i] );
+        Generate[i] = AddGate( GATE_AND, A[i], B[i] );
+    }
+
+    // After the level with span d, G[i] and P[i] cover bits i-2d+1 .. i
+    std::vector<int> GroupG( Generate ), GroupP( Propagate );
+    for( int Span = 1; Span < aBits; Span *= 2 )
+    {
+        std::vector<int> NextG( GroupG ), NextP( GroupP );
+        for( int i = Span; i < aBits; ++i )
+        {
+            int Carried = AddGate( GATE_AND, GroupP[i], GroupG[i - Span] );
+            NextG[i] = AddGate( GATE_OR, GroupG[i], Carried );
+            if( i >= 2 * Span )
+                NextP[i] = AddGate( GATE_AND, GroupP[i], GroupP[i - Span] );
+        }
+        GroupG.swap( NextG );
+        GroupP.swap( NextP );
+    }
+
+    AddOutput( Propagate[0], "S0" );
+    for( int i = 1; i < aBits; ++i )
+        AddOutput( AddGate( GATE_XOR, Propagate[i], GroupG[i - 1] ), "S" + std::to_string( i ) );
+    AddOutput( GroupG[aBits - 1], "Cout" );
+
+    BuildFanout();
+}
+
+void CNetlist::BuildMiter( const CNetlist& aFirst, const CNetlist& aSecond )
+{
+    std::vector<int> Inputs;
+    for( size_t i = 0; i < aFirst.mInputNames.size(); ++i )
+        Inputs.push_back( AddInput( aFirst.mInputNames[i] ) );
+
+    std::vector<int> FirstOutputs = AddCopyOf( aFirst, Inputs );
+    std::vector<int> SecondOutputs = AddCopyOf( aSecond, Inputs );
+
+    std::vector<int> Differences;
+    for( size_t o = 0; o < FirstOutputs.size(); ++o )
+        Differences.push_back( AddGate( GATE_XOR, FirstOutputs[o], SecondOutputs[o] ) );
+
+    // Balanced OR tree so the miter output is not a long chain
+    while( Differences.size() > 1 )
+    {
+        std::vector<int> Next;
+        for( size_t d = 0; d + 1 < Differences.size(); d += 2 )
+            Next.push_back( AddGate( GATE_OR, Differences[d], Differences[d + 1] ) );
+        if( Differences.size() % 2 == 1 )
+            Next.push_back( Differences.back() );
+        Differences.swap( Next );
+    }
+
+    AddOutput( Differences[0], "Differ" );
+    BuildFanout();
+}
+
+std::vector<int> CNetlist::AddCopyOf( const CNetlist& aOther, const std::vector<int>& aInputNets )
+{
+    // Maps each of aOther's nets to the net it becomes in this netlist
+    std::vector<int> NetMap( aOther.GetNumNets(), -1 );
+    for( size_t i = 0; i < aOther.mInputNets.size(); ++i )
+        NetMap[aOther.mInputNets[i]] = aInputNets[i];
+
+    for( size_t g = 0; g < aOther.mGates.size(); ++g )
+    {
+        const Gate& OtherGate = aOther.mGates[g];
+        NetMap[OtherGate.Output] = AddGate( OtherGate.Type,
+            NetMap[OtherGate.Inputs[0]], NetMap[OtherGate.Inputs[1]] );
+    }
+
+    std::vector<int> Outputs;
+    for( size_t o = 0; o < aOther.mOutputNets.size(); ++o )
+        Outputs.push_back( NetMap[aOther.mOutputNets[o]] );
+    return Outputs;
+}
+
+// Counting sort of gate inputs by net, so each net's readers are contiguous
+void CNetlist::BuildFanout()
+{
+    int NumNets = GetNumNets();
+    mFanoutStart.assign( NumNets + 1, 0 );
+    for( size_t g = 0; g < mGates.size(); ++g )
+    {
+        ++mFanoutStart[mGates[g].Inputs[0] + 1];
+        ++mFanoutStart[mGates[g].Inputs[1] + 1];
+    }
+
+    for( int n = 0; n < NumNets; ++n )
+        mFanoutStart[n + 1] += mFanoutStart[n];
+
+    std::vector<int> Next( mFanoutStart.begin(), mFanoutStart.end() - 1 );
+    mFanoutGates.resize( mFanoutStart[NumNets] );
+    for( size_t g = 0; g < mGates.size(); ++g )
+    {
+        mFanoutGates[Next[mGates[g].Inputs[0]]++] = (int)g;
+        mFanoutGates[Next[mGates[g].Inputs[1]]++] = (int)g;
+    }
+}
+
+int CNetlist::GetNumNets() const
+{
+    return (int)mDriver.size();
+}
+
+size_t CNetlist::GetMemoryBytes() const
+{
+    size_t Bytes = sizeof( CNetlist ) + mGates.capacity() * sizeof( Gate );
+    Bytes += ( mInputNets.capacity() + mOutputNets.capacity() + mDriver.capacity() ) * sizeof( int );
+    Bytes += ( mFanoutStart.capacity() + mFanoutGates.capacity() ) * sizeof( int );
+    Bytes += ( mInputNames.capacity() + mOutputNames.capacity() ) * sizeof( std::string );
+    for( size_t i = 0; i < mInputNames.size(); ++i )
+        Bytes += mInputNames[i].capacity();
+    for( size_t o = 0; o < mOutputNames.size(); ++o )
+        Bytes += mOutputNames[o].capacity();
+    return Bytes;
+}
+
+eLogicLevel CNetlist::EvaluateGate( eGateType aType, eLogicLevel aInputA, eLogicLevel aInputB )
+{
+    if( aInputA == LOGIC_UNDEFINED || aInputB == LOGIC_UNDEFINED )
+        return LOGIC_UNDEFINED;
+
+    bool A = ( aInputA == LOGIC_HIGH );
+    bool B = ( aInputB == LOGIC_HIGH );
+    bool Out = false;
+    switch( aType )
+    {
+        case GATE_NAND: Out = !( A && B ); break;
+        case GATE_AND:  Out = A && B;      break;
+        case GATE_OR:   Out = A || B;      break;
+        case GATE_XOR:  Out = A != B;      break;
+        default: break;
+    }
+    return Out ? LOGIC_HIGH : LOGIC_LOW;
+}
+
+//---CTimingWheel Implementation-----------------------------------------------
+// Rounds the slot count up to a power of two so the slot index is a mask
+CTimingWheel::CTimingWheel( int aMaxDelay )
+{
+    long NumSlots = 1;
+    while( NumSlots <= aMaxDelay )
+        NumSlots <<= 1;
+
+    mSlots.resize( NumSlots );
+    mSlotMask = NumSlots - 1;
+    mCurrentTime = 0;
+    mNumPending = 0;
+}
+
+void CTimingWheel::Schedule( long aTime, int aNet, eLogicLevel aLevel )
+{
+    Event NewEvent;
+    NewEvent.Net = aNet;
+    NewEvent.Level = aLevel;
+    mSlots[aTime & mSlotMask].push_back( NewEvent );
+    ++mNumPending;
+}
+
+// Steps forward one slot at a time; with events pending this takes at most one lap
+bool CTimingWheel::PopNextSlot( long& aTime, std::vector<Event>& aEvents )
+{
+    aEvents.clear();
+    if( mNumPending == 0 )
+        return false;
+
+    while( mSlots[mCurrentTime & mSlotMask].empty() )
+        ++mCurrentTime;
+
+    // Swapping keeps both buffers' capacity, so steady state does not allocate
+    aEvents.swap( mSlots[mCurrentTime & mSlotMask] );
+    mNumPending -= (long)aEvents.size();
+    aTime = mCurrentTime;
+    return true;
+}
+
+long CTimingWheel::GetCurrentTime() const
+{
+    return mCurrentTime;
+}
+
+//---CTimingSimulator Implementation-------------------------------------------
+// Every net starts undefined, as CGate does
+CTimingSimulator::CTimingSimulator( const CNetlist& aNetlist )
+    : mNetlist( aNetlist ),
+      mWheel( *std::max_element( GateDelays, GateDelays + NUM_GATE_TYPES ) )
+{
+    int NumNets = mNetlist.GetNumNets();
+    mLevels.assign( NumNets, LOGIC_UNDEFINED );
+    mProjected.assign( NumNets, LOGIC_UNDEFINED );
+    mLastChange.assign( NumNets, 0 );
+    mGateStamp.assign( mNetlist.mGates.size(), -1 );
+    mSlotsRun = 0;
+    mEventsProcessed = 0;
+    mSettleTime = 0;
+}
+
+void CTimingSimulator::DriveInput( int aInputIndex, eLogicLevel aLevel )
+{
+    int Net = mNetlist.mInputNets[aInputIndex];
+    if( mProjected[Net] == aLevel )
+        return;
+
+    mProjected[Net] = aLevel;
+    mWheel.Schedule( mWheel.GetCurrentTime(), Net, aLevel );
+}
+
+long CTimingSimulator::Run()
+{
+    long Now;
+    while( mWheel.PopNextSlot( Now, mSlotEvents ) )
+    {
+        // Apply every change in this slot before looking at any gate
+        mGatesToEvaluate.clear();
+        ++mSlotsRun;
+        for( size_t e = 0; e < mSlotEvents.size(); ++e )
+        {
+            int Net = mSlotEvents[e].Net;
+            ++mEventsProcessed;
+            if( mLevels[Net] == mSlotEvents[e].Level )
+                continue;
+
+            mLevels[Net] = mSlotEvents[e].Level;
+            mLastChange[Net] = Now;
+            mSettleTime = Now;
+
+            for( int f = mNetlist.mFanoutStart[Net]; f < mNetlist.mFanoutStart[Net + 1]; ++f )
+            {
+                int GateIndex = mNetlist.mFanoutGates[f];
+                if( mGateStamp[GateIndex] != mSlotsRun )
+                {
+                    mGateStamp[GateIndex] = mSlotsRun;
+                    mGatesToEvaluate.push_back( GateIndex );
+                }
+            }
+        }
+
+        // Only schedule outputs that will actually end up at a new level
+        for( size_t g = 0; g < mGatesToEvaluate.size(); ++g )
+        {
+            const CNetlist::Gate& ThisGate = mNetlist.mGates[mGatesToEvaluate[g]];
+            eLogicLevel NewLevel = CNetlist::EvaluateGate( ThisGate.Type,
+                mLevels[ThisGate.Inputs[0]], mLevels[ThisGate.Inputs[1]] );
+
+            if( NewLevel != mProjected[ThisGate.Output] )
+            {
+                mProjected[ThisGate.Output] = NewLevel;
+                mWheel.Schedule( Now + GateDelays[ThisGate.Type], ThisGate.Output, NewLevel );
+            }
+        }
+    }
+    return mSettleTime;
+}
+
+eLogicLevel CTimingSimulator::GetNetLevel( int aNet ) const
+{
+    return mLevels[aNet];
+}
+
+long CTimingSimulator::GetLastChangeTime( int aNet ) const
+{
+    return mLastChange[aNet];
+}
+
+long CTimingSimulator::GetEventsProcessed() const
+{
+    return mEventsProcessed;
+}
+
+//---CStaticTiming Implementation----------------------------------------------
+// One sweep in topological order: a gate's output arrives its delay after its latest input
+long CStaticTiming::Analyse( const CNetlist& aNetlist )
+{
+    int NumNets = aNetlist.GetNumNets();
+    mArrival.assign( NumNets, 0 );
+    mCriticalInput.assign( NumNets, -1 );
+
+    for( size_t g = 0; g < aNetlist.mGates.size(); ++g )
+    {
+        const CNetlist::Gate& ThisGate = aNetlist.mGates[g];
+        int Latest = ThisGate.Inputs[0];
+        if( mArrival[ThisGate.Inputs[1]] > mArrival[Latest] )
+            Latest = ThisGate.Inputs[1];
+
+        mArrival[ThisGate.Output] = mArrival[Latest] + GateDelays[ThisGate.Type];
+        mCriticalInput[ThisGate.Output] = Latest;
+    }
+
+    mWorstOutput = -1;
+    long WorstArrival = 0;
+    for( size_t o = 0; o < aNetlist.mOutputNets.size(); ++o )
+    {
+        int Net = aNetlist.mOutputNets[o];
+        if( mWorstOutput == -1 || mArrival[Net] > WorstArrival )
+        {
+            mWorstOutput = (int)o;
+            WorstArrival = mArrival[Net];
+        }
+    }
+    return WorstArrival;
+}
+
+// Walks back from the worst output through each gate's latest input
+void CStaticTiming::ReportCriticalPath( const CNetlist& aNetlist )
+{
+    if( mWorstOutput == -1 )
+        return;
+
+    std::vector<int> Path;
+    for( int Net = aNetlist.mOutputNets[mWorstOutput]; Net != -1; Net = mCriticalInput[Net] )
+        Path.push_back( Net );
+
+    std::cout << "Critical path to " << aNetlist.mOutputNames[mWorstOutput] << " ("
+              << Path.size() - 1 << " gates, " << mArrival[Path[0]] << " ps):\n";
+
+    int NumSteps = (int)Path.size();
+    for( int i = NumSteps - 1; i >= 0; --i )
+    {
+        int Step = NumSteps - 1 - i;
+        if( NumSteps > MaxReportedPathSteps && Step == MaxReportedPathSteps / 2 )
+        {
+            std::cout << "  ... " << NumSteps - MaxReportedPathSteps << " more gates ...\n";
+            i = MaxReportedPathSteps - MaxReportedPathSteps / 2;
+            continue;
+        }
+
+        int Net = Path[i];
+        int Driver = aNetlist.mDriver[Net];
+        if( Driver == -1 )
+        {
+            for( size_t in = 0; in < aNetlist.mInputNets.size(); ++in )
+            {
+                if( aNetlist.mInputNets[in] == Net )
+                    std::cout << "  input " << aNetlist.mInputNames[in];
+            }
+        }
+        else
+            std::cout << "  " << GateNames[aNetlist.mGates[Driver].Type] << " gate " << Driver;
+
+        std::cout << " -> net " << Net << " @ " << mArrival[Net] << " ps\n";
+    }
+}
+
+//---CBddManager Implementation------------------------------------------------
+// Nodes 0 and 1 are the constant terminals, sitting below every variable
+CBddManager::CBddManager( int aNumVars, int aNodeLimit )
+{
+    mNumVars = aNumVars;
+    mNodeLimit = aNodeLimit;
+
+    Node Terminal;
+    Terminal.Var = aNumVars;
+    Terminal.Low = Terminal.High = False;
+    mNodes.push_back( Terminal );
+    Terminal.Low = Terminal.High = True;
+    mNodes.push_back( Terminal );
+
+    Resize( InitialBddTableSize );
+}
+
+// Doubling the unique table keeps it at most half full; cached results are
+// only an optimisation, so the computed cache is simply cleared
+void CBddManager::Resize( int aTableSize )
+{
+    mUniqueTable.assign( aTableSize, -1 );
+    for( int n = True + 1; n < (int)mNodes.size(); ++n )
+        mUniqueTable[FindSlot( mNodes[n].Var, mNodes[n].Low, mNodes[n].High )] = n;
+
+    CacheEntry Empty = { -1, -1, -1, -1 };
+    mComputedCache.assign( aTableSize / 2, Empty );
+}
+
+// Slot holding (aVar, aLow, aHigh), or the empty slot where it belongs
+size_t CBddManager::FindSlot( int aVar, int aLow, int aHigh ) const
+{
+    size_t Mask = mUniqueTable.size() - 1;
+    size_t Slot = ( (size_t)aVar * 12582917u + (size_t)aLow * 4256249u + (size_t)aHigh * 741457u ) & Mask;
+    while( mUniqueTable[Slot] != -1 )
+    {
+        const Node& Existing = mNodes[mUniqueTable[Slot]];
+        if( Existing.Var == aVar && Existing.Low == aLow && Existing.High == aHigh )
+            break;
+        Slot = ( Slot + 1 ) & Mask;
+    }
+    return Slot;
+}
+
+int CBddManager::Variable( int aVar )
+{
+    return MakeNode( aVar, False, True );
+}
+
+// Returns the existing node for (aVar, aLow, aHigh) or adds it
+int CBddManager::MakeNode( int aVar, int aLow, int aHigh )
+{
+    if( aLow == aHigh )
+        return aLow;
+
+    size_t Slot = FindSlot( aVar, aLow, aHigh );
+    if( mUniqueTable[Slot] != -1 )
+        return mUniqueTable[Slot];
+
+    if( (int)mNodes.size() >= mNodeLimit )
+        return -1;
+
+    Node NewNode;
+    NewNode.Var = aVar;
+    NewNode.Low = aLow;
+    NewNode.High = aHigh;
+    mUniqueTable[Slot] = (int)mNodes.size();
+    mNodes.push_back( NewNode );
+
+    int NewIndex = (int)mNodes.size() - 1;
+    if( 2 * mNodes.size() > mUniqueTable.size() )
+        Resize( 2 * (int)mUniqueTable.size() );
+    return NewIndex;
+}
+
+// Result when both operands are terminals, or when one operand decides it alone
+int CBddManager::ApplyTerminal( eGateType aOp, int aF, int aG )
+{
+    bool FTerminal = ( aF <= True );
+    bool GTerminal = ( aG <= True );
+    if( FTerminal && GTerminal )
+    {
+        return CNetlist::EvaluateGate( aOp, aF == True ? LOGIC_HIGH : LOGIC_LOW,
+            aG == True ? LOGIC_HIGH : LOGIC_LOW ) == LOGIC_HIGH ? True : False;
+    }
+
+    switch( aOp )
+    {
+        case GATE_AND:
+            if( aF == False || aG == False ) return False;
+            if( aF == True ) return aG;
+            if( aG == True || aF == aG ) return aF;
+            break;
+        case GATE_OR:
+            if( aF == True || aG == True ) return True;
+            if( aF == False ) return aG;
+            if( aG == False || aF == aG ) return aF;
+            break;
+        case GATE_XOR:
+            if( aF == aG ) return False;
+            if( aF == False ) return aG;
+            if( aG == False ) return aF;
+            break;
+        case GATE_NAND:
+            if( aF == False || aG == False ) return True;
+            break;
+        default:
+            break;
+    }
+    return -1;
+}
+
+// Shannon expansion on the topmost variable of the two operands
+int CBddManager::Apply( eGateType aOp, int aF, int aG )
+{
+    if( aF < 0 || aG < 0 )
+        return -1;
+
+    int Result = ApplyTerminal( aOp, aF, aG );
+    if( Result != -1 )
+        return Result;
+
+    // Every op here is symmetric, so order the operands to share cache entries
+    if( aF > aG )
+        std::swap( aF, aG );
+
+    size_t CacheHash = (size_t)aF * 2654435761u ^ (size_t)aG * 40503u ^ (size_t)aOp;
+    const CacheEntry& Cached = mComputedCache[CacheHash & ( mComputedCache.size() - 1 )];
+    if( Cached.Op == aOp && Cached.F == aF && Cached.G == aG )
+        return Cached.Result;
+
+    int Var = std::min( mNodes[aF].Var, mNodes[aG].Var );
+    int FLow = ( mNodes[aF].Var == Var ) ? mNodes[aF].Low : aF;
+    int FHigh = ( mNodes[aF].Var == Var ) ? mNodes[aF].High : aF;
+    int GLow = ( mNodes[aG].Var == Var ) ? mNodes[aG].Low : aG;
+    int GHigh = ( mNodes[aG].Var == Var ) ? mNodes[aG].High : aG;
+
+    int Low = Apply( aOp, FLow, GLow );
+    int High = Apply( aOp, FHigh, GHigh );
+    if( Low < 0 || High < 0 )
+        return -1;
+
+    // The recursion may have resized the cache, so look the entry up again
+    Result = MakeNode( Var, Low, High );
+    if( Result >= 0 )
+    {
+        CacheEntry& Entry = mComputedCache[CacheHash & ( mComputedCache.size() - 1 )];
+        Entry.Op = aOp;
+        Entry.F = aF;
+        Entry.G = aG;
+        Entry.Result = Result;
+    }
+    return Result;
+}
+
+// Follows any path to the True terminal, inputs not on the path are left low
+void CBddManager::FindSatisfying( int aF, std::vector<eLogicLevel>& aAssignment )
+{
+    aAssignment.assign( mNumVars, LOGIC_LOW );
+    while( aF > True )
+    {
+        const Node& ThisNode = mNodes[aF];
+        if( ThisNode.High != False )
+        {
+            aAssignment[ThisNode.Var] = LOGIC_HIGH;
+            aF = ThisNode.High;
+        }
+        else
+            aF = ThisNode.Low;
+    }
+}
+
+int CBddManager::GetNumNodes() const
+{
+    return (int)mNodes.size();
+}
+
+//---CEquivalenceChecker Implementation----------------------------------------
+// Builds the miter and its BDD one gate at a time in topological order
+bool CEquivalenceChecker::Check( const CNetlist& aFirst, const CNetlist& aSecond )
+{
+    mCounterexample.clear();
+    mBddNodes = 0;
+
+    if( aFirst.mInputNets.size() != aSecond.mInputNets.size() ||
+        aFirst.mOutputNets.size() != aSecond.mOutputNets.size() )
+    {
+        std::cout << "The circuits have different numbers of inputs or outputs" << std::endl;
+        return false;
+    }
+
+    CNetlist Miter;
+    Miter.BuildMiter( aFirst, aSecond );
+
+    CBddManager Bdd( (int)Miter.mInputNets.size(), MaxBddNodes );
+    std::vector<int> NetBdd( Miter.GetNumNets(), -1 );
+    for( size_t i = 0; i < Miter.mInputNets.size(); ++i )
+        NetBdd[Miter.mInputNets[i]] = Bdd.Variable( (int)i );
+
+    for( size_t g = 0; g < Miter.mGates.size(); ++g )
+    {
+        const CNetlist::Gate& ThisGate = Miter.mGates[g];
+        NetBdd[ThisGate.Output] = Bdd.Apply( ThisGate.Type,
+            NetBdd[ThisGate.Inputs[0]], NetBdd[ThisGate.Inputs[1]] );
+
+        if( NetBdd[ThisGate.Output] < 0 )
+        {
+            std::cout << "BDD node limit of " << MaxBddNodes << " reached, no result" << std::endl;
+            mBddNodes = Bdd.GetNumNodes();
+            return false;
+        }
+    }
+    mBddNodes = Bdd.GetNumNodes();
+
+    int Differ = NetBdd[Miter.mOutputNets[0]];
+    if( Differ == CBddManager::False )
+        return true;
+
+    Bdd.FindSatisfying( Differ, mCounterexample );
+    return false;
+}
+
+//---CXoshiro256 Implementation------------------------------------------------
+// splitmix64 spreads the seed over the whole state, which must not be all zero
+CXoshiro256::CXoshiro256( uint64_t aSeed )
+{
+    for( int i = 0; i < 4; ++i )
+    {
+        aSeed += 0x9E3779B97F4A7C15ull;
+        uint64_t Mixed = aSeed;
+        Mixed = ( Mixed ^ ( Mixed >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+        Mixed = ( Mixed ^ ( Mixed >> 27 ) ) * 0x94D049BB133111EBull;
+        mState[i] = Mixed ^ ( Mixed >> 31 );
+    }
+}
+
+uint64_t CXoshiro256::Next()
+{
+    uint64_t Product = mState[1] * 5;
+    uint64_t Result = ( ( Product << 7 ) | ( Product >> 57 ) ) * 9;
+    uint64_t Shifted = mState[1] << 17;
+
+    mState[2] ^= mState[0];
+    mState[3] ^= mState[1];
+    mState[1] ^= mState[2];
+    mState[0] ^= mState[3];
+    mState[2] ^= Shifted;
+    mState[3] = ( mState[3] << 45 ) | ( mState[3] >> 19 );
+    return Result;
+}
+
+// Jump polynomial from the xoshiro256 reference implementation
+void CXoshiro256::Jump()
+{
+    static const uint64_t JumpTable[4] = { 0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull,
+                                           0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull };
+    uint64_t NewState[4] = { 0, 0, 0, 0 };
+    for( int w = 0; w < 4; ++w )
+    {
+        for( int b = 0; b < 64; ++b )
+        {
+            if( JumpTable[w] & ( 1ull << b ) )
+            {
+                for( int i = 0; i < 4; ++i )
+                    NewState[i] ^= mState[i];
+            }
+            Next();
+        }
+    }
+
+    for( int i = 0; i < 4; ++i )
+        mState[i] = NewState[i];
+}
+
+//---CLaneSimulator Implementation---------------------------------------------
+CLaneSimulator::CLaneSimulator( const CNetlist& aNetlist )
+    : mNetlist( aNetlist ),
+      mNetWords( aNetlist.GetNumNets(), 0 )
+{
+}
+
+// Gates are in topological order, so one sweep settles every lane
+void CLaneSimulator::Evaluate( const uint64_t* aInputWords, uint64_t* aOutputWords )
+{
+    for( size_t i = 0; i < mNetlist.mInputNets.size(); ++i )
+        mNetWords[mNetlist.mInputNets[i]] = aInputWords[i];
+
+    const CNetlist::Gate* Gates = mNetlist.mGates.data();
+    uint64_t* Words = mNetWords.data();
+    size_t NumGates = mNetlist.mGates.size();
+    for( size_t g = 0; g < NumGates; ++g )
+    {
+        uint64_t A = Words[Gates[g].Inputs[0]];
+        uint64_t B = Words[Gates[g].Inputs[1]];
+        uint64_t Out = 0;
+        switch( Gates[g].Type )
+        {
+            case GATE_NAND: Out = ~( A & B ); break;
+            case GATE_AND:  Out = A & B;      break;
+            case GATE_OR:   Out = A | B;      break;
+            case GATE_XOR:  Out = A ^ B;      break;
+            default: break;
+        }
+        Words[Gates[g].Output] = Out;
+    }
+
+    for( size_t o = 0; o < mNetlist.mOutputNets.size(); ++o )
+        aOutputWords[o] = mNetWords[mNetlist.mOutputNets[o]];
+}
+
+//---CStressTester Implementation----------------------------------------------
+CStressTester::CStressTester( const CNetlist& aCircuit, int aBits, ReferenceFunction aReference )
+    : mCircuit( aCircuit ),
+      mBits( aBits ),
+      mReference( aReference ),
+      mFailed( false ),
+      mPassesRun( 0 )
+{
+    mVectorsRun = 0;
+    mSeconds = 0;
+    mFailFirst = mFailSecond = mFailExpected = mFailActual = 0;
+
+    int NumOutputs = (int)aCircuit.mOutputNets.size();
+    mOutputMask = ( NumOutputs >= 64 ) ? ~0ull : ( ( 1ull << NumOutputs ) - 1 );
+}
+
+bool CStressTester::Run( uint64_t aSeed, long aVectors, int aThreads )
+{
+    if( aThreads < 1 )
+        aThreads = 1;
+
+    long TotalPasses = ( aVectors + LanesPerWord - 1 ) / LanesPerWord;
+    mFailed = false;
+    mPassesRun = 0;
+
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    std::vector<std::thread> Threads;
+    for( int t = 0; t < aThreads; ++t )
+    {
+        long Passes = TotalPasses / aThreads + ( t < TotalPasses % aThreads ? 1 : 0 );
+        Threads.push_back( std::thread( &CStressTester::Worker, this, t, aSeed, Passes ) );
+    }
+    for( size_t t = 0; t < Threads.size(); ++t )
+        Threads[t].join();
+
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+    mSeconds = Elapsed.count();
+    mVectorsRun = mPassesRun * LanesPerWord;
+    return !mFailed;
+}
+
+// Each pass fills the input lanes from the generator, simulates them, then
+// transposes inputs and outputs so lane l becomes the integers of vector l
+void CStressTester::Worker( int aThread, uint64_t aSeed, long aPasses )
+{
+    CXoshiro256 Random( aSeed );
+    for( int j = 0; j < aThread; ++j )
+        Random.Jump();
+
+    CLaneSimulator Simulator( mCircuit );
+    std::vector<uint64_t> InputWords( mCircuit.mInputNets.size() );
+    std::vector<uint64_t> OutputWords( mCircuit.mOutputNets.size() );
+    uint64_t FirstLanes[64], SecondLanes[64], OutputLanes[64];
+
+    long Pass;
+    for( Pass = 0; Pass < aPasses && !mFailed; ++Pass )
+    {
+        for( size_t i = 0; i < InputWords.size(); ++i )
+            InputWords[i] = Random.Next();
+
+        Simulator.Evaluate( InputWords.data(), OutputWords.data() );
+
+        for( int b = 0; b < 64; ++b )
+        {
+            FirstLanes[b] = ( b < mBits ) ? InputWords[2 * b] : 0;
+            SecondLanes[b] = ( b < mBits ) ? InputWords[2 * b + 1] : 0;
+            OutputLanes[b] = ( b < (int)OutputWords.size() ) ? OutputWords[b] : 0;
+        }
+        Transpose64( FirstLanes );
+        Transpose64( SecondLanes );
+        Transpose64( OutputLanes );
+
+        for( int l = 0; l < LanesPerWord; ++l )
+        {
+            uint64_t Expected = mReference( FirstLanes[l], SecondLanes[l] ) & mOutputMask;
+            if( Expected != OutputLanes[l] )
+            {
+                std::lock_guard<std::mutex> Lock( mFailLock );
+                if( !mFailed )
+                {
+                    mFailFirst = FirstLanes[l];
+                    mFailSecond = SecondLanes[l];
+                    mFailExpected = Expected;
+                    mFailActual = OutputLanes[l];
+                    mFailed = true;
+                }
+                break;
+            }
+        }
+    }
+    mPassesRun += Pass;
+}
+
+// Recursive block swap: swaps the off-diagonal 32x32 blocks, then 16x16 ...
+void CStressTester::Transpose64( uint64_t aWords[64] )
+{
+    uint64_t Mask = 0x00000000FFFFFFFFull;
+    for( int Width = 32; Width != 0; Width >>= 1, Mask ^= Mask << Width )
+    {
+        for( int k = 0; k < 64; k = ( ( k | Width ) + 1 ) & ~Width )
+        {
+            uint64_t Swap = ( ( aWords[k] >> Width ) ^ aWords[k | Width] ) & Mask;
+            aWords[k] ^= Swap << Width;
+            aWords[k | Width] ^= Swap;
+        }
+    }
+}
+
+//---CResultWriter Implementation----------------------------------------------
+// The buffer is allocated once here and reused for the whole run
+CResultWriter::CResultWriter( FILE* apFile, eResultFormat aFormat, size_t aBufferSize )
+    : mBuffer( aBufferSize )
+{
+    mpFile = apFile;
+    mFormat = aFormat;
+    mUsed = 0;
+}
+
+CResultWriter::~CResultWriter()
+{
+    Flush();
+}
+
+bool CResultWriter::ParseFormat( const char* aName, eResultFormat& aFormat )
+{
+    if( strcmp( aName, "binary" ) == 0 )
+        aFormat = FORMAT_BINARY;
+    else if( strcmp( aName, "hex" ) == 0 )
+        aFormat = FORMAT_HEX;
+    else if( strcmp( aName, "raw" ) == 0 )
+        aFormat = FORMAT_RAW;
+    else
+        return false;
+    return true;
+}
+
+// Binary keeps undefined bits visible, the packed formats read them as low
+void CResultWriter::WriteResult( const eLogicLevel* aBits, int aNumBits )
+{
+    if( mFormat != FORMAT_BINARY )
+    {
+        uint64_t Value = 0;
+        for( int i = 0; i < aNumBits; ++i )
+            Value = ( Value << 1 ) | ( aBits[i] == LOGIC_HIGH ? 1 : 0 );
+        WriteResult( Value, aNumBits );
+        return;
+    }
+
+    Reserve( aNumBits + 1 );
+    char* pOut = &mBuffer[mUsed];
+    for( int i = 0; i < aNumBits; ++i )
+        pOut[i] = ( aBits[i] == LOGIC_UNDEFINED ) ? 'X' : (char)( '0' + aBits[i] );
+    pOut[aNumBits] = '\n';
+    mUsed += aNumBits + 1;
+}
+
+// Text formats are one result per line, raw is little-endian bytes back to back
+void CResultWriter::WriteResult( uint64_t aValue, int aNumBits )
+{
+    static const char HexDigits[] = "0123456789abcdef";
+    Reserve( aNumBits + 1 );
+    char* pOut = &mBuffer[mUsed];
+
+    if( mFormat == FORMAT_BINARY )
+    {
+        for( int i = 0; i < aNumBits; ++i )
+            pOut[i] = (char)( '0' + ( ( aValue >> ( aNumBits - 1 - i ) ) & 1 ) );
+        pOut[aNumBits] = '\n';
+        mUsed += aNumBits + 1;
+    }
+    else if( mFormat == FORMAT_HEX )
+    {
+        int NumDigits = ( aNumBits + 3 ) / 4;
+        for( int i = 0; i < NumDigits; ++i )
+            pOut[i] = HexDigits[( aValue >> ( 4 * ( NumDigits - 1 - i ) ) ) & 0xF];
+        pOut[NumDigits] = '\n';
+        mUsed += NumDigits + 1;
+    }
+    else
+    {
+        int NumBytes = ( aNumBits + 7 ) / 8;
+        for( int i = 0; i < NumBytes; ++i )
+            pOut[i] = (char)( aValue >> ( 8 * i ) );
+        mUsed += NumBytes;
+    }
+}
+
+void CResultWriter::WriteText( const char* aText )
+{
+    size_t Length = strlen( aText );
+    Reserve( Length );
+    memcpy( &mBuffer[mUsed], aText, Length );
+    mUsed += Length;
+}
+
+eResultFormat CResultWriter::GetFormat() const
+{
+    return mFormat;
+}
+
+void CResultWriter::Flush()
+{
+    if( mUsed > 0 )
+    {
+        fwrite( mBuffer.data(), 1, mUsed, mpFile );
+        mUsed = 0;
+    }
+    fflush( mpFile );
+}
+
+// Anything larger than the whole buffer grows it once rather than being split
+void CResultWriter::Reserve( size_t aBytes )
+{
+    if( mUsed + aBytes <= mBuffer.size() )
+        return;
+
+    Flush();
+    if( aBytes > mBuffer.size() )
+        mBuffer.resize( aBytes );
+}
+
+//---CDesign Implementation----------------------------------------------------
+CDesign::CDesign()
+{
+    mTop = -1;
+    mFlattenedValid = false;
+}
+
+int CDesign::AddDefinition( const std::string& aName, const std::vector<std::string>& aInputNames,
+                            const std::vector<std::string>& aOutputNames, int aBusWidth )
+{
+    CModuleDef Definition;
+    Definition.mName = aName;
+    Definition.mBusWidth = aBusWidth;
+    Definition.mLastOutputNet = 0;
+    for( size_t i = 0; i < aInputNames.size(); ++i )
+    {
+        Definition.mInputNames += aInputNames[i];
+        Definition.mInputNames += '\0';
+    }
+    for( size_t o = 0; o < aOutputNames.size(); ++o )
+    {
+        Definition.mOutputNames += aOutputNames[o];
+        Definition.mOutputNames += '\0';
+    }
+
+    std::vector<std::string> Names;
+    ExpandPortNames( Definition.mInputNames, aBusWidth, Names );
+    Definition.mNumInputs = (int)Names.size();
+    Definition.mNumNets = Definition.mNumInputs;
+    ExpandPortNames( Definition.mOutputNames, aBusWidth, Names );
+    Definition.mNumOutputs = (int)Names.size();
+
+    mDefinitions.push_back( Definition );
+    mFlattenedValid = false;
+    return (int)mDefinitions.size() - 1;
+}
+
+int CDesign::AddGate( int aDefinition, eGateType aType, int aInputA, int aInputB )
+{
+    CModuleDef& Definition = mDefinitions[aDefinition];
+    AppendCode( Definition.mItems, aType );
+    AppendCode( Definition.mItems, Definition.mNumNets - aInputA );
+    AppendCode( Definition.mItems, Definition.mNumNets - aInputB );
+    mFlattenedValid = false;
+    return Definition.mNumNets++;
+}
+
+void CDesign::AddInstance( int aDefinition, int aSubDefinition, const std::vector<int>& aInputs, std::vector<int>& aOutputs )
+{
+    CModuleDef& Definition = mDefinitions[aDefinition];
+    AppendCode( Definition.mItems, NUM_GATE_TYPES + aSubDefinition );
+    for( size_t i = 0; i < aInputs.size(); ++i )
+        AppendCode( Definition.mItems, Definition.mNumNets - aInputs[i] );
+
+    aOutputs.clear();
+    for( int o = 0; o < mDefinitions[aSubDefinition].mNumOutputs; ++o )
+        aOutputs.push_back( Definition.mNumNets++ );
+    mFlattenedValid = false;
+}
+
+// Steps back are odd and steps forward even, so the code stays unsigned
+void CDesign::AddOutput( int aDefinition, int aNet )
+{
+    CModuleDef& Definition = mDefinitions[aDefinition];
+    int Step = aNet - Definition.mLastOutputNet;
+    AppendCode( Definition.mOutputNets, Step < 0 ? 2 * (unsigned)-Step - 1 : 2 * (unsigned)Step );
+    Definition.mLastOutputNet = aNet;
+    mFlattenedValid = false;
+}
+
+void CDesign::SetTop( int aDefinition )
+{
+    mTop = aDefinition;
+    mFlattenedValid = false;
+}
+
+// Full adder ports follow CFullAdder::FullAdderOutput: carry in, A, B
+void CDesign::BuildRippleAdder( int aBits )
+{
+    std::vector<std::string> Inputs, Outputs;
+    Inputs.push_back( "A" );
+    Inputs.push_back( "B" );
+    Outputs.push_back( "Sum" );
+    Outputs.push_back( "Carry" );
+    int HalfAdder = AddDefinition( "HalfAdder", Inputs, Outputs );
+    AddOutput( HalfAdder, AddGate( HalfAdder, GATE_XOR, 0, 1 ) );
+    AddOutput( HalfAdder, AddGate( HalfAdder, GATE_AND, 0, 1 ) );
+
+    Inputs.insert( Inputs.begin(), "CarryIn" );
+    int FullAdder = AddDefinition( "FullAdder", Inputs, Outputs );
+    std::vector<int> Nets( 2 ), Half1, Half2;
+    Nets[0] = 0;
+    Nets[1] = 1;
+    AddInstance( FullAdder, HalfAdder, Nets, Half1 );
+    Nets[0] = 2;
+    Nets[1] = Half1[0];
+    AddInstance( FullAdder, HalfAdder, Nets, Half2 );
+    AddOutput( FullAdder, Half2[0] );
+    AddOutput( FullAdder, AddGate( FullAdder, GATE_OR, Half1[1], Half2[1] ) );
+
+    Inputs.assign( 1, "A#" );
+    Inputs.push_back( "B#" );
+    Outputs.assign( 1, "S#" );
+    Outputs.push_back( "Cout" );
+    int Top = AddDefinition( "RippleAdder" + std::to_string( aBits ), Inputs, Outputs, aBits );
+
+    std::vector<int> Adder;
+    Nets.assign( 2, 0 );
+    Nets[1] = 1;
+    AddInstance( Top, HalfAdder, Nets, Adder );
+    AddOutput( Top, Adder[0] );
+
+    Nets.resize( 3 );
+    for( int i = 1; i < aBits; ++i )
+    {
+        Nets[0] = Adder[1];
+        Nets[1] = 2 * i;
+        Nets[2] = 2 * i + 1;
+        AddInstance( Top, FullAdder, Nets, Adder );
+        AddOutput( Top, Adder[0] );
+    }
+    AddOutput( Top, Adder[1] );
+    SetTop( Top );
+    Compact();
+}
+
+void CDesign::Compact()
+{
+    mDefinitions.shrink_to_fit();
+    for( size_t d = 0; d < mDefinitions.size(); ++d )
+    {
+        mDefinitions[d].mInputNames.shrink_to_fit();
+        mDefinitions[d].mOutputNames.shrink_to_fit();
+        mDefinitions[d].mItems.shrink_to_fit();
+        mDefinitions[d].mOutputNets.shrink_to_fit();
+    }
+}
+
+const CNetlist& CDesign::GetFlattened()
+{
+    if( mFlattenedValid )
+        return mFlattened;
+
+    mFlattened = CNetlist();
+    mFlattenedValid = true;
+    if( mTop == -1 )
+        return mFlattened;
+
+    const CModuleDef& Top = mDefinitions[mTop];
+    std::vector<std::string> Names;
+    std::vector<int> Inputs, Outputs;
+    ExpandPortNames( Top.mInputNames, Top.mBusWidth, Names );
+    for( size_t i = 0; i < Names.size(); ++i )
+        Inputs.push_back( mFlattened.AddInput( Names[i] ) );
+
+    FlattenDefinition( mTop, Inputs, Outputs, mFlattened );
+    ExpandPortNames( Top.mOutputNames, Top.mBusWidth, Names );
+    for( size_t o = 0; o < Outputs.size(); ++o )
+        mFlattened.AddOutput( Outputs[o], Names[o] );
+
+    mFlattened.BuildFanout();
+    return mFlattened;
+}
+
+void CDesign::ReleaseFlattened()
+{
+    mFlattened = CNetlist();
+    mFlattenedValid = false;
+}
+
+// Items are in topological order, so every local net is mapped before it is read
+void CDesign::FlattenDefinition( int aDefinition, const std::vector<int>& aInputs, std::vector<int>& aOutputs,
+                                 CNetlist& aFlat ) const
+{
+    const CModuleDef& Definition = mDefinitions[aDefinition];
+    std::vector<int> LocalToFlat( Definition.mNumNets, -1 );
+    for( int i = 0; i < Definition.mNumInputs; ++i )
+        LocalToFlat[i] = aInputs[i];
+
+    int NextNet = Definition.mNumInputs;
+    std::vector<int> SubInputs, SubOutputs;
+    const uint8_t* pCode = Definition.mItems.data();
+    const uint8_t* pEnd = pCode + Definition.mItems.size();
+    while( pCode < pEnd )
+    {
+        unsigned Kind = ReadCode( pCode );
+        if( Kind < NUM_GATE_TYPES )
+        {
+            int InputA = LocalToFlat[NextNet - (int)ReadCode( pCode )];
+            int InputB = LocalToFlat[NextNet - (int)ReadCode( pCode )];
+            LocalToFlat[NextNet++] = aFlat.AddGate( (eGateType)Kind, InputA, InputB );
+            continue;
+        }
+
+        int SubDefinition = Kind - NUM_GATE_TYPES;
+        SubInputs.clear();
+        for( int i = 0; i < mDefinitions[SubDefinition].mNumInputs; ++i )
+            SubInputs.push_back( LocalToFlat[NextNet - (int)ReadCode( pCode )] );
+
+        FlattenDefinition( SubDefinition, SubInputs, SubOutputs, aFlat );
+        for( size_t o = 0; o < SubOutputs.size(); ++o )
+            LocalToFlat[NextNet++] = SubOutputs[o];
+    }
+
+    aOutputs.clear();
+    int Net = 0;
+    pCode = Definition.mOutputNets.data();
+    for( int o = 0; o < Definition.mNumOutputs; ++o )
+    {
+        unsigned Step = ReadCode( pCode );
+        Net += ( Step & 1 ) ? -(int)( ( Step + 1 ) / 2 ) : (int)( Step / 2 );
+        aOutputs.push_back( LocalToFlat[Net] );
+    }
+}
+
+void CDesign::ExpandPortNames( const std::string& aPatterns, int aBusWidth, std::vector<std::string>& aNames )
+{
+    aNames.clear();
+    const char* pName = aPatterns.c_str();
+    const char* pEnd = pName + aPatterns.size();
+    while( pName < pEnd )
+    {
+        std::vector<const char*> Bus;
+        while( pName < pEnd && pName[strlen( pName ) - 1] == '#' )
+        {
+            Bus.push_back( pName );
+            pName += strlen( pName ) + 1;
+        }
+        for( int Bit = 0; Bit < aBusWidth && !Bus.empty(); ++Bit )
+        {
+            for( size_t b = 0; b < Bus.size(); ++b )
+                aNames.push_back( std::string( Bus[b], strlen( Bus[b] ) - 1 ) + std::to_string( Bit ) );
+        }
+
+        if( pName < pEnd )
+        {
+            aNames.push_back( pName );
+            pName += strlen( pName ) + 1;
+        }
+    }
+}
+
+void CDesign::AppendCode( std::vector<uint8_t>& aCode, unsigned aValue )
+{
+    while( aValue >= 0x80 )
+    {
+        aCode.push_back( (uint8_t)( aValue | 0x80 ) );
+        aValue >>= 7;
+    }
+    aCode.push_back( (uint8_t)aValue );
+}
+
+unsigned CDesign::ReadCode( const uint8_t*& apCode )
+{
+    unsigned Value = 0;
+    for( int Shift = 0; ; Shift += 7 )
+    {
+        uint8_t Byte = *apCode++;
+        Value |= (unsigned)( Byte & 0x7F ) << Shift;
+        if( Byte < 0x80 )
+            return Value;
+    }
+}
+
+size_t CDesign::GetMemoryBytes() const
+{
+    size_t Bytes = sizeof( CDesign ) - sizeof( CNetlist ) + mDefinitions.capacity() * sizeof( CModuleDef ) + GetPortNameBytes();
+    for( size_t d = 0; d < mDefinitions.size(); ++d )
+        Bytes += mDefinitions[d].mItems.capacity() + mDefinitions[d].mOutputNets.capacity();
+    return Bytes;
+}
+
+size_t CDesign::GetPortNameBytes() const
+{
+    size_t Bytes = 0;
+    for( size_t d = 0; d < mDefinitions.size(); ++d )
+        Bytes += mDefinitions[d].mInputNames.capacity() + mDefinitions[d].mOutputNames.capacity();
+    return Bytes;
+}
+
+//---CTestParallelAdder Implementation-----------------------------------------
+// Runs static timing, then simulates the worst-case carry ripple: from all zeros
+// to A = 00..1 and B = 11..1, so the carry generated at bit 0 travels through
+// the XOR-AND-OR path of every full adder to Cout.
+bool CTestParallelAdder::TestTiming( int aBits )
+{
+    if( aBits < 1 )
+    {
+        std::cout << "The adder needs at least 1 bit" << std::endl;
+        return false;
+    }
+
+    CNetlist Adder;
+    Adder.BuildRippleAdder( aBits );
+    std::cout << aBits << "-bit ripple adder: " << Adder.mGates.size() << " gates, "
+              << Adder.GetNumNets() << " nets\n";
+
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    CStaticTiming Timing;
+    long WorstArrival = Timing.Analyse( Adder );
+    std::chrono::duration<double> StaTime = std::chrono::steady_clock::now() - Start;
+
+    std::cout << "Static timing: worst arrival " << WorstArrival << " ps, analysed in "
+              << StaTime.count() * 1e3 << " ms\n";
+    Timing.ReportCriticalPath( Adder );
+
+    // With every B high, raising A0 alone flips S0 and sends a carry down the
+    // whole chain, so the last output settles at the worst arrival
+    CTimingSimulator Simulator( Adder );
+    for( int i = 0; i < (int)Adder.mInputNets.size(); ++i )
+        Simulator.DriveInput( i, ( i % 2 == 1 ) ? LOGIC_HIGH : LOGIC_LOW );
+    long InitialSettle = Simulator.Run();
+
+    Start = std::chrono::steady_clock::now();
+    Simulator.DriveInput( 0, LOGIC_HIGH );
+    long Settle = Simulator.Run();
+    std::chrono::duration<double> SimTime = std::chrono::steady_clock::now() - Start;
+
+    bool SettledOnTime = ( Settle - InitialSettle == WorstArrival );
+    std::cout << "Delay simulation: outputs settled " << Settle - InitialSettle
+              << " ps after the inputs changed, " << Simulator.GetEventsProcessed()
+              << " events, simulated in " << SimTime.count() * 1e3 << " ms\n"
+              << "Settle time matches the worst arrival: " << ( SettledOnTime ? "PASS" : "FAIL" ) << "\n";
+
+    // Inputs driven again at the time the last Run() ended must still reach
+    // every gate they feed: n1 = A AND C, n2 = n1 AND C, with C raised last
+    CNetlist Chain;
+    int InputA = Chain.AddInput( "A" );
+    int InputC = Chain.AddInput( "C" );
+    int First = Chain.AddGate( GATE_AND, InputA, InputC );
+    int Second = Chain.AddGate( GATE_AND, First, InputC );
+    Chain.AddOutput( First, "n1" );
+    Chain.AddOutput( Second, "n2" );
+    Chain.BuildFanout();
+
+    CTimingSimulator ChainSimulator( Chain );
+    ChainSimulator.DriveInput( 0, LOGIC_LOW );
+    ChainSimulator.DriveInput( 1, LOGIC_LOW );
+    ChainSimulator.Run();
+    ChainSimulator.DriveInput( 0, LOGIC_HIGH );
+    ChainSimulator.Run();
+    ChainSimulator.DriveInput( 1, LOGIC_HIGH );
+    ChainSimulator.Run();
+
+    bool Passed = ChainSimulator.GetNetLevel( First ) == LOGIC_HIGH && ChainSimulator.GetNetLevel( Second ) == LOGIC_HIGH;
+    std::cout << "Repeated drives at one time: " << ( Passed ? "PASS" : "FAIL" ) << std::endl;
+    return Passed && SettledOnTime;
+}
+
+// Checks the ripple adder against the prefix adder, then against a copy of
+// itself with one carry OR gate turned into an AND
+bool CTestParallelAdder::TestEquivalence( int aBits )
+{
+    if( aBits < 1 )
+    {
+        std::cout << "The adder needs at least 1 bit" << std::endl;
+        return false;
+    }
+
+    CNetlist Ripple, Prefix;
+    Ripple.BuildRippleAdder( aBits );
+    Prefix.BuildPrefixAdder( aBits );
+    std::cout << aBits << "-bit ripple adder: " << Ripple.mGates.size() << " gates, prefix adder: "
+              << Prefix.mGates.size() << " gates\n";
+
+    CNetlist Broken = Ripple;
+    for( size_t g = Broken.mGates.size(); g-- > 0; )
+    {
+        if( Broken.mGates[g].Type == GATE_OR )
+        {
+            Broken.mGates[g].Type = GATE_AND;
+            break;
+        }
+    }
+
+    const CNetlist* Candidates[] = { &Prefix, &Broken };
+    const char* CandidateNames[] = { "prefix adder", "broken ripple adder" };
+    bool Expected[] = { true, false };
+    bool Passed = true;
+    for( int c = 0; c < 2; ++c )
+    {
+        CEquivalenceChecker Checker;
+        std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+        bool Equivalent = Checker.Check( Ripple, *Candidates[c] );
+        std::chrono::duration<double> CheckTime = std::chrono::steady_clock::now() - Start;
+        Passed = Passed && Equivalent == Expected[c];
+
+        std::cout << "Ripple adder vs " << CandidateNames[c] << ": "
+                  << ( Equivalent ? "equivalent" : "NOT equivalent" ) << " ("
+                  << Checker.mBddNodes << " BDD nodes, " << CheckTime.count() * 1e3 << " ms)\n";
+
+        // Inputs are interleaved A0, B0, A1, B1 ..., printed here MSB first
+        if( !Checker.mCounterexample.empty() )
+        {
+            std::string FirstNumber, SecondNumber;
+            for( int i = aBits - 1; i >= 0; --i )
+            {
+                FirstNumber += ( Checker.mCounterexample[2 * i] == LOGIC_HIGH ) ? '1' : '0';
+                SecondNumber += ( Checker.mCounterexample[2 * i + 1] == LOGIC_HIGH ) ? '1' : '0';
+            }
+            std::cout << "  Counterexample: A = " << FirstNumber << ", B = " << SecondNumber << "\n";
+        }
+    }
+    std::cout << std::flush;
+    return Passed;
+}
+
+// Both adder architectures against the CPU's own addition
+bool CTestParallelAdder::TestStress( int aBits, long aVectors, uint64_t aSeed, int aThreads )
+{
+    if( aBits < 1 || aBits > MaxStressBits )
+    {
+        std::cout << "The stress test supports 1 to " << MaxStressBits << " bit adders" << std::endl;
+        return false;
+    }
+
+    CNetlist Ripple, Prefix;
+    Ripple.BuildRippleAdder( aBits );
+    Prefix.BuildPrefixAdder( aBits );
+
+    const CNetlist* Circuits[] = { &Ripple, &Prefix };
+    const char* CircuitNames[] = { "ripple adder", "prefix adder" };
+    bool AllPassed = true;
+    for( int c = 0; c < 2; ++c )
+    {
+        CStressTester Tester( *Circuits[c], aBits,
+            []( uint64_t aFirst, uint64_t aSecond ) -> uint64_t { return aFirst + aSecond; } );
+        bool Passed = Tester.Run( aSeed, aVectors, aThreads );
+
+        double VectorsPerSecond = Tester.mVectorsRun / Tester.mSeconds;
+        std::cout << aBits << "-bit " << CircuitNames[c] << ": " << ( Passed ? "PASS" : "FAIL" ) << ", "
+                  << Tester.mVectorsRun << " vectors on " << aThreads << " threads (seed " << aSeed << ") in "
+                  << Tester.mSeconds << " s, " << VectorsPerSecond / 1e6 << " M vectors/s, "
+                  << VectorsPerSecond * 3600 / 1e9 << " G vectors/hour\n";
+
+        if( !Passed )
+        {
+            std::cout << "  " << Tester.mFailFirst << " + " << Tester.mFailSecond << " expected "
+                      << Tester.mFailExpected << " but the circuit gave " << Tester.mFailActual << "\n";
+        }
+        AllPassed = AllPassed && Passed;
+    }
+    std::cout << std::flush;
+    return AllPassed;
+}
+
+// Generates random sums with the lane simulator, then times writing them out.
+// The iostream baseline is the old ParallelAdderOutput style: one std::cout
+// insertion per result and std::endl after each.
+void CTestParallelAdder::TestOutputBenchmark( eResultFormat aFormat, long aResults, const char* aFileName )
+{
+    CNetlist Adder;
+    Adder.BuildRippleAdder( BenchmarkBits );
+    CLaneSimulator Simulator( Adder );
+    CXoshiro256 Random( DefaultStressSeed );
+
+    // Results are computed up front so only the output stage is timed
+    long NumPasses = ( aResults + LanesPerWord - 1 ) / LanesPerWord;
+    std::vector<uint64_t> Results( NumPasses * LanesPerWord );
+    std::vector<uint64_t> InputWords( Adder.mInputNets.size() );
+    uint64_t OutputLanes[64];
+    for( long Pass = 0; Pass < NumPasses; ++Pass )
+    {
+        for( size_t i = 0; i < InputWords.size(); ++i )
+            InputWords[i] = Random.Next();
+
+        Simulator.Evaluate( InputWords.data(), OutputLanes );
+        for( int l = 0; l < LanesPerWord; ++l )
+        {
+            uint64_t Value = 0;
+            for( size_t o = 0; o < Adder.mOutputNets.size(); ++o )
+                Value |= ( ( OutputLanes[o] >> l ) & 1 ) << o;
+            Results[Pass * LanesPerWord + l] = Value;
+        }
+    }
+
+    FILE* pFile = fopen( aFileName, "wb" );
+    if( pFile == NULL )
+    {
+        std::cerr << "Could not open " << aFileName << std::endl;
+        return;
+    }
+
+    FILE* Sinks[] = { stdout, pFile };
+    const char* SinkNames[] = { "stdout", aFileName };
+    for( int k = 0; k < 2; ++k )
+    {
+        std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+        {
+            CResultWriter Writer( Sinks[k], aFormat );
+            for( size_t r = 0; r < Results.size(); ++r )
+                Writer.WriteResult( Results[r], BenchmarkBits + 1 );
+        }
+        std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+        std::cerr << "Buffered writer to " << SinkNames[k] << ": " << Results.size() / Elapsed.count() / 1e6
+                  << " M results/s" << std::endl;
+    }
+    fclose( pFile );
+
+    // The baseline writes the same bytes to its own file, one character at a
+    // time and flushed after every result
+    std::string BaselineName = std::string( aFileName ) + ".iostream";
+    std::ofstream Baseline( BaselineName.c_str(), std::ios::binary );
+    int NumBits = BenchmarkBits + 1;
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    for( size_t r = 0; r < Results.size(); ++r )
+    {
+        if( aFormat == FORMAT_BINARY )
+        {
+            for( int b = NumBits - 1; b >= 0; --b )
+                Baseline << (char)( '0' + ( ( Results[r] >> b ) & 1 ) );
+            Baseline << std::endl;
+        }
+        else if( aFormat == FORMAT_HEX )
+        {
+            for( int d = ( NumBits + 3 ) / 4 - 1; d >= 0; --d )
+                Baseline << "0123456789abcdef"[( Results[r] >> ( 4 * d ) ) & 0xF];
+            Baseline << std::endl;
+        }
+        else
+        {
+            for( int i = 0; i < ( NumBits + 7 ) / 8; ++i )
+                Baseline << (char)( Results[r] >> ( 8 * i ) );
+            Baseline << std::flush;
+        }
+    }
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+    std::cerr << "iostream flushed per result to " << BaselineName << ": " << Results.size() / Elapsed.count() / 1e6
+              << " M results/s" << std::endl;
+}
+
+// The old object model keeps one CFullAdder (gates and wires included) per bit,
+// the CHalfAdders FullAdderOutput builds are only temporaries; the design needs
+// the two definitions plus a few bytes of instance per bit
+bool CTestParallelAdder::TestHierarchy( int aBits )
+{
+    if( aBits < 1 )
+    {
+        std::cout << "The adder needs at least 1 bit" << std::endl;
+        return false;
+    }
+
+    CDesign Design;
+    Design.BuildRippleAdder( aBits );
+
+    size_t ObjectBytes = sizeof( CHalfAdder ) + ( aBits - 1 ) * sizeof( CFullAdder );
+    size_t DesignBytes = Design.GetMemoryBytes();
+    size_t NameBytes = Design.GetPortNameBytes();
+    std::cout << aBits << "-bit adder as CHalfAdder/CFullAdder objects: " << ObjectBytes << " bytes\n"
+              << aBits << "-bit adder as a hierarchical design: " << DesignBytes << " bytes ("
+              << DesignBytes - NameBytes << " structure, " << NameBytes << " port names)\n"
+              << "Objects to design ratio: " << (double)ObjectBytes / DesignBytes << "x\n";
+
+    // Simulating needs the flat netlist as well, built on the first request and kept for the next
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    const CNetlist& Flat = Design.GetFlattened();
+    std::chrono::duration<double> FlattenTime = std::chrono::steady_clock::now() - Start;
+    Start = std::chrono::steady_clock::now();
+    bool Cached = ( &Design.GetFlattened() == &Flat );
+    std::chrono::duration<double> CachedTime = std::chrono::steady_clock::now() - Start;
+    std::cout << "Flattened on first use to " << Flat.mGates.size() << " gates (" << Flat.GetMemoryBytes()
+              << " bytes) in " << FlattenTime.count() * 1e3 << " ms, "
+              << ( Cached ? "kept for the next use: " : "NOT kept for the next use: " )
+              << CachedTime.count() * 1e3 << " ms\n";
+
+    // Random vectors at any width, plus a BDD proof while the BDDs stay small
+    CNetlist Reference;
+    Reference.BuildRippleAdder( aBits );
+    CLaneSimulator FlatSimulator( Flat ), ReferenceSimulator( Reference );
+    CXoshiro256 Random( DefaultStressSeed );
+    std::vector<uint64_t> InputWords( Flat.mInputNets.size() );
+    std::vector<uint64_t> FlatOutputs( Flat.mOutputNets.size() ), ReferenceOutputs( Reference.mOutputNets.size() );
+    bool Matched = ( Flat.mInputNames == Reference.mInputNames && Flat.mOutputNames == Reference.mOutputNames );
+    for( int Pass = 0; Pass < HierarchyCheckPasses && Matched; ++Pass )
+    {
+        for( size_t i = 0; i < InputWords.size(); ++i )
+            InputWords[i] = Random.Next();
+
+        FlatSimulator.Evaluate( InputWords.data(), FlatOutputs.data() );
+        ReferenceSimulator.Evaluate( InputWords.data(), ReferenceOutputs.data() );
+        Matched = ( FlatOutputs == ReferenceOutputs );
+    }
+    std::cout << "Flattened design vs flat ripple adder on " << HierarchyCheckPasses * LanesPerWord
+              << " random vectors: " << ( Matched ? "match" : "MISMATCH" ) << "\n";
+
+    bool Equivalent = true;
+    if( aBits <= DefaultEquivalenceBits )
+    {
+        CEquivalenceChecker Checker;
+        Equivalent = Checker.Check( Reference, Flat );
+        std::cout << "Flattened design vs flat ripple adder: " << ( Equivalent ? "equivalent" : "NOT equivalent" ) << "\n";
+    }
+
+    Design.ReleaseFlattened();
+    std::cout << "Design after releasing the flat netlist: " << Design.GetMemoryBytes() << " bytes" << std::endl;
+    return Cached && Matched && Equivalent;
+}
@@ -1,47 +1,450 @@
 //--Includes-------------------------------------------------------------------
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <charconv>
+#include <cstdio>
+#include <cctype>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 //--Consts, enums and lists----------------------------------------------------
+enum eHemisphere { HEMISPHERE_NORTH, HEMISPHERE_SOUTH, NUM_HEMISPHERES };
+enum eContinent { CONTINENT_AFRICA, CONTINENT_ANTARCTICA, CONTINENT_ASIA, CONTINENT_EUROPE, CONTINENT_NORTH_AMERICA,
+                  CONTINENT_OCEANIA, CONTINENT_SOUTH_AMERICA, CONTINENT_UNKNOWN, NUM_CONTINENTS };
+
+const char* const HemisphereNames[NUM_HEMISPHERES] = { "North", "South" };
+const char* const ContinentNames[NUM_CONTINENTS] = { "Africa", "Antarctica", "Asia", "Europe", "North America",
+                                                     "Oceania", "South America", "Unknown" };
+
+const long DefaultGeneratedCountries = 200000;
+const int EquatorOneIn = 8;                                                 // About one generated country in 8 is on the equator
+const long DefaultBenchmarkCountries = 5000000;
+const int BenchmarkRepeats = 10;
+const int MaxListedMatches = 10;                                            // Matches a query prints, the rest are only counted
+const size_t MinWordsPerReportThread = 1024;                                // 65536 countries, fewer are not worth a thread
+const size_t TraceBufferBytes = 1 << 16;                                    // Written out once this much is waiting
+const char CatalogMagic[8] = { 'P', 'L', 'A', 'N', 'E', 'T', 'S', '\0' };
+const uint32_t CatalogVersion = 1;
+
+// Columns stored for each planet in a catalog file
+enum eCatalogSection { SECTION_NAME_OFFSETS, SECTION_NAMES, SECTION_EQUATOR, SECTION_HEMISPHERES, SECTION_CONTINENTS,
+                       SECTION_LATITUDES, SECTION_POPULATIONS, SECTION_BOUNDS, NUM_CATALOG_SECTIONS };
+
+const double GridCellDegrees = 1.0;                                         // Side of a spatial grid cell
+const int GridRows = 180;                                                   // 180 degrees of latitude
+const int GridColumns = 360;                                                // 360 degrees of longitude, wrapping round
 
 //---Forward Declarations------------------------------------------------------
+class CTrace;
 class CCountry;
+class CCountryQuery;
+class CPlanetCatalog;
 
 //---Interface-----------------------------------------------------------------
 
-class CPlanet 
+// Lines of tracing that are collected in a buffer and written in large
+// blocks, or not at all. It is off unless PLANET_TRACE is set, and callers
+// test IsEnabled() before building a line so it costs one branch when off.
+class CTrace
+{
+    public:
+        static void Enable(bool On);
+        static bool IsEnabled();
+
+        static void Write(std::string_view Line);
+        static void Flush();
+
+    private:
+        static bool Enabled;
+        static std::string Buffer;
+};
+
+// A read-only view of a whole file, mapped rather than read so a large file
+// is not copied before it is parsed
+class CMappedFile
+{
+    public:
+        CMappedFile();
+        ~CMappedFile();
+
+        bool Open(const char* FileName);
+        void Close();
+
+        const char* GetData() const;
+        size_t GetSize() const;
+
+    private:
+        const char* pData;
+        size_t Size;
+};
+
+// Countries are stored by column: all the names end to end in one arena with
+// an offset per country, and the equator flags packed 64 to a word. A query
+// only touches the column it needs, and the equator one is a few words.
+class CPlanet
 {
     public:
         CPlanet();
+        CPlanet(std::string PlanetName);
         ~CPlanet();
 
     // Sets the planets name
     void SetPlanetName(std::string PlanetName);
 
-    //Lists the countries on the planets equator to std out
-    void ReportEquitorials();
+    // Adds a country, copying its name into the name arena
+    void AddCountry(std::string_view Name, bool OnEquator);
+    void AddCountry(const CCountry& Country);
+
+    // Adds every "name,equator[,latitude,population,hemisphere,continent
+    // [,min latitude,max latitude,min longitude,max longitude]]" row of a CSV
+    // file in one pass over the mapped file. Names may be quoted. A
+    // first line that is not a country is taken as a header. Returns false
+    // with a message in Error on a bad row.
+    bool LoadCountries(const char* FileName, std::string& Error);
+
+    std::string_view GetCountryName(int Index) const;
+    CCountry GetCountry(int Index) const;
+    int GetNumberOfCountries() const;
+
+    // Popcount of the equator bitset
+    int CountEquitorials() const;
+
+    // Indices of the equatorial countries, found by scanning the set bits
+    void FindEquitorials(std::vector<int>& Indices) const;
+
+    //Lists the countries on the planets equator to std out, built by
+    //Threads threads (0 for one per core) and written in one go
+    void ReportEquitorials(int Threads = 0);
+
+    // The lines ReportEquitorials writes. Each thread scans its own run of
+    // equator words into its own buffer and the buffers are joined in order,
+    // so the output is the same for any number of threads.
+    void WriteEquitorials(std::string& Output, int Threads) const;
+
+    // Sets bit i of Matches for each country i that meets every condition of
+    // Query. Categories are ANDed in from their bitmaps a word at a time, and
+    // ranges are looked up in the sorted indexes by binary search.
+    void RunQuery(const CCountryQuery& Query, std::vector<uint64_t>& Matches);
+    int CountQuery(const CCountryQuery& Query);
+    void FindQuery(const CCountryQuery& Query, std::vector<int>& Indices);
+
+    // Sorts the range indexes if countries were added since the last query
+    void BuildIndexes();
+
+    // Countries whose bounding box overlaps the band of latitudes, in index
+    // order, read from the grid rows the band covers
+    void FindInLatitudeBand(double MinLatitude, double MaxLatitude, std::vector<int>& Indices);
+
+    // Country whose bounding box is closest to the point, searching rings of
+    // grid cells outwards until no closer box can be left. Distance is in
+    // degrees on a flat latitude/longitude map. -1 if no country has bounds.
+    int FindNearest(double Latitude, double Longitude, double* pDistance);
 
     private:
+        // Records a country whose name was just appended to the arena
+        void AppendCountry(const CCountry& Country);
+
+        static void AppendBit(std::vector<uint64_t>& Bits, int Index, bool Value);
+        static bool TestBit(const std::vector<uint64_t>& Bits, int Index);
+
+        // Clears the bits of Matches outside Min to Max of Column, using Sorted
+        template <class TColumn, class TValue>
+        void AndRange(const std::vector<int>& Sorted, const std::vector<TColumn>& Column, TValue Min, TValue Max,
+                      std::vector<uint64_t>& Matches);
+
+        // Reads "latitude,population,hemisphere,continent" and the bounds if there are any into Country
+        const char* ParseAttributes(const char* pPosition, const char* pEnd, CCountry& Country);
+
+        // Adds country Index to every grid cell its bounding box touches
+        void InsertIntoGrid(int Index);
+        static int GridRow(double Latitude);
+        static int GridColumn(double Longitude);
+        double DistanceToBounds(int Index, double Latitude, double Longitude) const;
+
+        // Appends a line for each equatorial country in EquatorBits[FirstWord] to [LastWord - 1]
+        void AppendEquitorials(size_t FirstWord, size_t LastWord, std::string* pOutput) const;
+
+        // Parses one field starting at pField and appends it to the name arena
+        // if Name is set. Returns the end of the field, or NULL if it is malformed.
+        const char* ParseField(const char* pField, const char* pEnd, bool Name);
+
         std::string m_PlanetName;
-        CCountry* pCountry;
+        std::string NameArena;                                              // Every country name, end to end
+        std::vector<uint32_t> NameOffsets;                                  // Country i's name is NameOffsets[i] to NameOffsets[i+1]
+        std::vector<uint64_t> EquatorBits;                                  // Bit i set if country i is on the equator
+        std::vector<float> Latitudes;
+        std::vector<uint64_t> Populations;
+        std::vector<uint64_t> HemisphereBits[NUM_HEMISPHERES];              // One bitmap per category value
+        std::vector<uint64_t> ContinentBits[NUM_CONTINENTS];
+        std::vector<int> ByLatitude;                                        // Country indices sorted by latitude
+        std::vector<int> ByPopulation;
+        std::vector<float> BoundsMinLatitude;                               // NaN for a country without bounds
+        std::vector<float> BoundsMaxLatitude;
+        std::vector<float> BoundsMinLongitude;                              // Above the max for a box that crosses 180
+        std::vector<float> BoundsMaxLongitude;
+        std::vector<std::vector<int>> GridCells;                            // Countries touching each cell, row by row from the south
+        bool IndexesDirty;
         int NumberOfCountries;
         bool IsOnEquator;
+
+        // Writes the columns straight out
+        friend class CPlanetCatalog;
 };
 
+// One country read back from the planet's columns
 class CCountry
 {
     public:
         CCountry();
-        ~CCountry();
 
-        std::string NameOfCountry;
+        std::string_view NameOfCountry;                                     // Points into the planet's name arena
         bool EquatorCheck;
+        double Latitude;                                                    // Degrees, north positive
+        uint64_t Population;
+        int Hemisphere;
+        int Continent;
+        double MinLatitude;                                                 // Bounding box, NaN if not known
+        double MaxLatitude;
+        double MinLongitude;                                                // West edge, east positive, above MaxLongitude if the box crosses 180
+        double MaxLongitude;
+
+        bool HasBounds() const;
+    private:
+};
+
+// Conditions on a planet's countries, all of which must hold. A condition
+// that is not set matches every country.
+class CCountryQuery
+{
+    public:
+        CCountryQuery();
+
+        // Adds one condition from text: "continent=Africa" (repeat for any
+        // of several), "hemisphere=south", "equator=1", "lat=-10:10" or
+        // "pop=1000000:" where an empty end of a range is unbounded
+        bool ParseCondition(const char* Condition);
+
+        // Continent or hemisphere from its name, ignoring case and spaces, or -1
+        static int FindContinent(std::string_view Name);
+        static int FindHemisphere(std::string_view Name);
+
+        uint32_t ContinentMask;                                             // Bit per allowed continent, 0 for any
+        int Hemisphere;                                                     // -1 for any
+        int Equator;                                                        // -1 for any
+        bool HasLatitude;
+        double MinLatitude;
+        double MaxLatitude;
+        bool HasPopulation;
+        uint64_t MinPopulation;
+        uint64_t MaxPopulation;
+};
+
+// Many planets in one binary file that is memory mapped, not read. Each
+// planet's columns are stored as they are in CPlanet (name offsets, names,
+// bitmaps, then the number columns), each 8-byte aligned, and a directory
+// at the end says where they are. Opening only checks the header and the
+// directory, and a query reads just the columns it needs straight from the
+// mapping, so no country is ever turned back into an object.
+// Numbers are stored in the machine's own byte order.
+class CPlanetCatalog
+{
+    public:
+        CPlanetCatalog();
+
+        static bool Save(const char* FileName, const std::vector<CPlanet*>& Planets, std::string& Error);
+
+        bool Open(const char* FileName, std::string& Error);
+
+        int GetNumberOfPlanets() const;
+        std::string_view GetPlanetName(int Planet) const;
+
+        // Index of the planet with this name, or -1
+        int FindPlanet(std::string_view Name) const;
+
+        int GetNumberOfCountries(int Planet) const;
+        std::string_view GetCountryName(int Planet, int Country) const;
+
+        // Popcount and bit scan of the planet's mapped equator bitmap
+        int CountEquitorials(int Planet) const;
+        void ReportEquitorials(int Planet, std::string& Output) const;
+
     private:
+        struct Header
+        {
+            char Magic[8];
+            uint32_t Version;
+            uint32_t NumberOfPlanets;
+            uint64_t DirectoryOffset;
+        };
+
+        struct PlanetEntry
+        {
+            uint64_t NameOffset;
+            uint64_t NameLength;
+            uint64_t NumberOfCountries;
+            uint64_t NamesSize;                                             // Bytes in the name arena
+            uint64_t Sections[NUM_CATALOG_SECTIONS];                        // File offset of each column
+        };
+
+        // Bytes in a section of a planet with this many countries
+        static uint64_t SectionSize(int Section, uint64_t Countries, uint64_t NamesSize);
+
+        // Appends Size bytes and pads to 8, returning where they start
+        static uint64_t WriteSection(std::ofstream& File, const void* pData, uint64_t Size);
+
+        template <class T>
+        const T* GetSection(int Planet, int Section) const;
+
+        CMappedFile File;
+        const PlanetEntry* pEntries;
+        int NumberOfPlanets;
 };
 
+// Loads each CSV as a planet named after the file and saves them all as a catalog
+bool BuildCatalog(const char* CatalogName, int NumberOfFiles, char* FileNames[]);
+
+// Opens a catalog and lists its planets, or the equatorial countries of one
+bool ReportCatalog(const char* CatalogName, const char* PlanetName);
+
+// Writes a CSV of Countries made up countries for LoadCountries
+bool GenerateCountries(long Countries, const char* FileName);
+
+// Loads FileName and prints the countries meeting every condition
+bool ReportQuery(const char* FileName, int NumberOfConditions, char* Conditions[]);
+
+// Loads FileName and prints the countries in a band of latitudes, or nearest a point
+bool ReportBand(const char* FileName, double MinLatitude, double MaxLatitude);
+bool ReportNearest(const char* FileName, double Latitude, double Longitude);
+
+// Times the equator queries on the columns against the old array of
+// objects with a std::string and a bool each
+void BenchmarkEquitorials(long Countries);
+
+// Times WriteEquitorials on a CSV with 1, 2, 4... up to MaxThreads threads
+bool BenchmarkReport(const char* FileName, int MaxThreads);
+
+// True if the whole of the text is one number
+template <class TValue>
+static bool ParseWhole(const char* pBegin, const char* pEnd, TValue& Value);
+
 
 //---Main----------------------------------------------------------------------
-int main(void) 
+int main(int argc, char* argv[])
 {
+    CTrace::Enable(getenv("PLANET_TRACE") != NULL);
+
+    // "generate [countries] <file>" writes a test CSV
+    if (argc > 2 && strcmp(argv[1], "generate") == 0)
+    {
+        long Countries = argc > 3 ? atol(argv[2]) : DefaultGeneratedCountries;
+        const char* FileName = argc > 3 ? argv[3] : argv[2];
+        return GenerateCountries(Countries, FileName) ? 0 : 1;
+    }
+
+    // "bench [countries]" times the equator query
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+    {
+        long Countries = argc > 2 ? atol(argv[2]) : DefaultBenchmarkCountries;
+        if (Countries < 1)
+        {
+            std::cout << "Need at least 1 country" << std::endl;
+            return 1;
+        }
+        BenchmarkEquitorials(Countries);
+        return 0;
+    }
+
+    // "report-bench <file> [max threads]" times the equator report across thread counts
+    if (argc > 2 && strcmp(argv[1], "report-bench") == 0)
+    {
+        int MaxThreads = argc > 3 ? atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+        return BenchmarkReport(argv[2], MaxThreads > 0 ? MaxThreads : 1) ? 0 : 1;
+    }
+
+    // "query <file> <conditions>" filters a CSV, see CCountryQuery::ParseCondition
+    if (argc > 2 && strcmp(argv[1], "query") == 0)
+    {
+        return ReportQuery(argv[2], argc - 3, argv + 3) ? 0 : 1;
+    }
+
+    // "catalog-build <catalog> <csv>..." saves CSVs as one catalog,
+    // "catalog <catalog> [planet]" opens one and reports on it
+    if (argc > 3 && strcmp(argv[1], "catalog-build") == 0)
+    {
+        return BuildCatalog(argv[2], argc - 3, argv + 3) ? 0 : 1;
+    }
+    if (argc > 2 && strcmp(argv[1], "catalog") == 0)
+    {
+        return ReportCatalog(argv[2], argc > 3 ? argv[3] : NULL) ? 0 : 1;
+    }
+
+    // "band <file> <min latitude> <max latitude>" and "nearest <file> <latitude> <longitude>"
+    // use the spatial grid, so "band <file> 0 0" lists the countries the equator crosses
+    if (argc > 4 && (strcmp(argv[1], "band") == 0 || strcmp(argv[1], "nearest") == 0))
+    {
+        double First;
+        double Second;
+        if (!ParseWhole(argv[3], argv[3] + strlen(argv[3]), First) || !ParseWhole(argv[4], argv[4] + strlen(argv[4]), Second))
+        {
+            std::cout << "Cannot read " << argv[3] << " " << argv[4] << " as two numbers" << std::endl;
+            return 1;
+        }
+
+        if (strcmp(argv[1], "band") == 0)
+        {
+            if (!(First >= -90 && Second <= 90 && First <= Second))
+            {
+                std::cout << "The band needs two latitudes from -90 to 90, the southern one first" << std::endl;
+                return 1;
+            }
+            return ReportBand(argv[2], First, Second) ? 0 : 1;
+        }
+
+        if (!(First >= -90 && First <= 90 && Second >= -180 && Second <= 180))
+        {
+            std::cout << "The point needs a latitude from -90 to 90 and a longitude from -180 to 180" << std::endl;
+            return 1;
+        }
+        return ReportNearest(argv[2], First, Second) ? 0 : 1;
+    }
+
+    // "load <file>" bulk loads a CSV and reports on it
+    if (argc > 2 && strcmp(argv[1], "load") == 0)
+    {
+        CPlanet Earth("Earth");
+        std::string Error;
+
+        std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+        if (!Earth.LoadCountries(argv[2], Error))
+        {
+            std::cout << Error << std::endl;
+            return 1;
+        }
+        std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+
+        struct stat FileStat;
+        double Megabytes = stat(argv[2], &FileStat) == 0 ? FileStat.st_size / 1e6 : 0;
+        std::cerr << "Loaded " << Earth.GetNumberOfCountries() << " countries (" << Megabytes << " MB) in " << Elapsed.count()
+                  << " s: " << Earth.GetNumberOfCountries() / Elapsed.count() / 1e6 << " million rows/s, "
+                  << Megabytes / Elapsed.count() << " MB/s" << std::endl;
+
+        Earth.ReportEquitorials();
+        return 0;
+    }
+
     CPlanet Earth;
     Earth.ReportEquitorials();
 }
@@ -50,55 +453,1506 @@ int main(void)
 
 CPlanet::CPlanet()
 {
+    IsOnEquator = false;
 
     std::cout << "Enter the name of the Planet: ";
     std::cin >> m_PlanetName;
 
     std::cout << "Enter the amount of countries for that planet: " << std::endl;
-    std::cin >> NumberOfCountries;
-    
+    int Count = 0;
+    std::cin >> Count;
+
     // Instantiating the number of countries in the planet
-    pCountry = new CCountry[NumberOfCountries];
+    NumberOfCountries = 0;
+    NameOffsets.push_back(0);
+    IndexesDirty = false;
+    for (int i = 0; i < Count; i++)
+    {
+        std::string NameOfCountry;
+        bool EquatorCheck = false;
+
+        std::cout << "What is the name of the country: ";
+        std::cin >> NameOfCountry;
+
+        std::cout << "Enter a 1 or a 0 if the country lies on the equator: ";
+        std::cin >> EquatorCheck;
+
+        AddCountry(NameOfCountry, EquatorCheck);
+        std::cout << "Country " << NameOfCountry << " created." << std::endl;
+    }
+}
+
+CPlanet::CPlanet(std::string PlanetName)
+{
+    m_PlanetName = PlanetName;
+    NumberOfCountries = 0;
+    NameOffsets.push_back(0);
+    IndexesDirty = false;
+    IsOnEquator = false;
 }
 
+// The members free themselves, the loop is only for the trace.
+// Countries go in reverse order, as delete [] used to destroy them.
 CPlanet::~CPlanet()
 {
-    std::cout << m_PlanetName << " Dtor." << std::endl;
-    delete [] pCountry;
+    if (CTrace::IsEnabled())
+    {
+        CTrace::Write(m_PlanetName + " Dtor.");
+        for (int i = NumberOfCountries - 1; i >= 0; i--)
+        {
+            std::string Line(GetCountryName(i));
+            CTrace::Write(Line + " Dtor.");
+        }
+    }
+}
+
+void CPlanet::SetPlanetName(std::string PlanetName)
+{
+    m_PlanetName = PlanetName;
+}
+
+void CPlanet::AddCountry(std::string_view Name, bool OnEquator)
+{
+    CCountry Country;
+    Country.NameOfCountry = Name;
+    Country.EquatorCheck = OnEquator;
+    AddCountry(Country);
+}
+
+void CPlanet::AddCountry(const CCountry& Country)
+{
+    NameArena.append(Country.NameOfCountry.data(), Country.NameOfCountry.size());
+    AppendCountry(Country);
+}
+
+void CPlanet::AppendCountry(const CCountry& Country)
+{
+    AppendBit(EquatorBits, NumberOfCountries, Country.EquatorCheck);
+    for (int h = 0; h < NUM_HEMISPHERES; h++)
+    {
+        AppendBit(HemisphereBits[h], NumberOfCountries, Country.Hemisphere == h);
+    }
+    for (int c = 0; c < NUM_CONTINENTS; c++)
+    {
+        AppendBit(ContinentBits[c], NumberOfCountries, Country.Continent == c);
+    }
+    Latitudes.push_back((float)Country.Latitude);
+    Populations.push_back(Country.Population);
+    BoundsMinLatitude.push_back((float)Country.MinLatitude);
+    BoundsMaxLatitude.push_back((float)Country.MaxLatitude);
+    BoundsMinLongitude.push_back((float)Country.MinLongitude);
+    BoundsMaxLongitude.push_back((float)Country.MaxLongitude);
+    NameOffsets.push_back((uint32_t)NameArena.size());
+    NumberOfCountries++;
+    IndexesDirty = true;
+
+    // The grid is kept up to date on every insert rather than rebuilt
+    if (Country.HasBounds())
+    {
+        InsertIntoGrid(NumberOfCountries - 1);
+    }
+}
+
+void CPlanet::InsertIntoGrid(int Index)
+{
+    if (GridCells.empty())
+    {
+        GridCells.resize(GridRows * GridColumns);
+    }
+
+    int FirstRow = GridRow(BoundsMinLatitude[Index]);
+    int LastRow = GridRow(BoundsMaxLatitude[Index]);
+    int FirstColumn = GridColumn(BoundsMinLongitude[Index]);
+    int LastColumn = GridColumn(BoundsMaxLongitude[Index]);
+
+    // A box that crosses 180 runs east from its first column and wraps round to its last
+    int Columns = LastColumn - FirstColumn + 1 + (BoundsMinLongitude[Index] > BoundsMaxLongitude[Index] ? GridColumns : 0);
+    Columns = Columns < GridColumns ? Columns : GridColumns;
+    for (int Row = FirstRow; Row <= LastRow; Row++)
+    {
+        for (int c = 0; c < Columns; c++)
+        {
+            GridCells[Row * GridColumns + (FirstColumn + c) % GridColumns].push_back(Index);
+        }
+    }
+}
+
+int CPlanet::GridRow(double Latitude)
+{
+    int Row = (int)floor((Latitude + 90) / GridCellDegrees);
+    return Row < 0 ? 0 : (Row >= GridRows ? GridRows - 1 : Row);
+}
+
+int CPlanet::GridColumn(double Longitude)
+{
+    int Column = (int)floor((Longitude + 180) / GridCellDegrees);
+    return Column < 0 ? 0 : (Column >= GridColumns ? GridColumns - 1 : Column);
+}
+
+// Longitude wraps, so a box can be nearer going the other way round
+double CPlanet::DistanceToBounds(int Index, double Latitude, double Longitude) const
+{
+    double LatitudeGap = Latitude < BoundsMinLatitude[Index] ? BoundsMinLatitude[Index] - Latitude
+                       : (Latitude > BoundsMaxLatitude[Index] ? Latitude - BoundsMaxLatitude[Index] : 0);
+
+    // A box that crosses 180 holds the longitudes east of its west edge or west of its east edge
+    bool PastWestEdge = Longitude >= BoundsMinLongitude[Index];
+    bool BeforeEastEdge = Longitude <= BoundsMaxLongitude[Index];
+    bool Inside = BoundsMinLongitude[Index] <= BoundsMaxLongitude[Index] ? PastWestEdge && BeforeEastEdge
+                                                                        : PastWestEdge || BeforeEastEdge;
+    double LongitudeGap = 0;
+    if (!Inside)
+    {
+        double East = fmod(BoundsMinLongitude[Index] - Longitude + 720, 360);
+        double West = fmod(Longitude - BoundsMaxLongitude[Index] + 720, 360);
+        LongitudeGap = East < West ? East : West;
+    }
+    return sqrt(LatitudeGap * LatitudeGap + LongitudeGap * LongitudeGap);
+}
+
+// A country spanning several cells of the band is met more than once, the bitmap keeps it once and in order
+void CPlanet::FindInLatitudeBand(double MinLatitude, double MaxLatitude, std::vector<int>& Indices)
+{
+    Indices.clear();
+    if (GridCells.empty())
+    {
+        return;
+    }
+
+    // The bounds are stored as floats, so the band is compared at the same precision
+    float BandMin = (float)MinLatitude;
+    float BandMax = (float)MaxLatitude;
+
+    std::vector<uint64_t> Found(EquatorBits.size(), 0);
+    for (int Row = GridRow(MinLatitude); Row <= GridRow(MaxLatitude); Row++)
+    {
+        for (int Column = 0; Column < GridColumns; Column++)
+        {
+            const std::vector<int>& Cell = GridCells[Row * GridColumns + Column];
+            for (size_t i = 0; i < Cell.size(); i++)
+            {
+                int Index = Cell[i];
+                if (BoundsMinLatitude[Index] <= BandMax && BoundsMaxLatitude[Index] >= BandMin)
+                {
+                    Found[Index / 64] |= 1ull << (Index % 64);
+                }
+            }
+        }
+    }
+
+    for (size_t w = 0; w < Found.size(); w++)
+    {
+        for (uint64_t Word = Found[w]; Word != 0; Word &= Word - 1)
+        {
+            Indices.push_back((int)(w * 64 + __builtin_ctzll(Word)));
+        }
+    }
+}
+
+// Every cell in ring k is at least (k - 1) cells from the point in some
+// direction, so once the best box is closer than that the search can stop
+int CPlanet::FindNearest(double Latitude, double Longitude, double* pDistance)
+{
+    int Best = -1;
+    double BestDistance = 1e300;
+    if (GridCells.empty())
+    {
+        return Best;
+    }
+
+    int CenterRow = GridRow(Latitude);
+    int CenterColumn = GridColumn(Longitude);
+    int MaxRing = GridRows > GridColumns / 2 ? GridRows : GridColumns / 2;
+    for (int Ring = 0; Ring <= MaxRing && BestDistance > (Ring - 1) * GridCellDegrees; Ring++)
+    {
+        for (int Row = CenterRow - Ring; Row <= CenterRow + Ring; Row++)
+        {
+            if (Row < 0 || Row >= GridRows)
+            {
+                continue;
+            }
+
+            // Whole rows at the top and bottom of the ring, only the two ends in between
+            int Step = Row == CenterRow - Ring || Row == CenterRow + Ring ? 1 : 2 * Ring;
+            for (int Offset = -Ring; Offset <= Ring; Offset += Step > 0 ? Step : 1)
+            {
+                int Column = ((CenterColumn + Offset) % GridColumns + GridColumns) % GridColumns;
+                const std::vector<int>& Cell = GridCells[Row * GridColumns + Column];
+                for (size_t i = 0; i < Cell.size(); i++)
+                {
+                    double Distance = DistanceToBounds(Cell[i], Latitude, Longitude);
+                    if (Distance < BestDistance || (Distance == BestDistance && Cell[i] < Best))
+                    {
+                        Best = Cell[i];
+                        BestDistance = Distance;
+                    }
+                }
+            }
+        }
+    }
+
+    if (pDistance != NULL)
+    {
+        *pDistance = BestDistance;
+    }
+    return Best;
+}
+
+void CPlanet::AppendBit(std::vector<uint64_t>& Bits, int Index, bool Value)
+{
+    if (Index % 64 == 0)
+    {
+        Bits.push_back(0);
+    }
+    Bits.back() |= (uint64_t)Value << (Index % 64);
+}
+
+bool CPlanet::TestBit(const std::vector<uint64_t>& Bits, int Index)
+{
+    return (Bits[Index / 64] >> (Index % 64)) & 1;
 }
 
-void CPlanet::ReportEquitorials() 
-{   
-    std::cout << "The Planets that are on the equator are: " << std::endl;
+bool CPlanet::LoadCountries(const char* FileName, std::string& Error)
+{
+    CMappedFile File;
+    if (!File.Open(FileName))
+    {
+        Error = std::string("Cannot open ") + FileName;
+        return false;
+    }
+
+    const char* pPosition = File.GetData();
+    const char* pEnd = pPosition + File.GetSize();
+
+    // Every byte of the file is at most one byte of name, and a row is at least four bytes
+    NameArena.reserve(NameArena.size() + File.GetSize());
+    NameOffsets.reserve(NameOffsets.size() + File.GetSize() / 4);
+    EquatorBits.reserve(EquatorBits.size() + File.GetSize() / 4 / 64 + 1);
+    Latitudes.reserve(Latitudes.size() + File.GetSize() / 4);
+    BoundsMinLatitude.reserve(BoundsMinLatitude.size() + File.GetSize() / 4);
+    BoundsMaxLatitude.reserve(BoundsMaxLatitude.size() + File.GetSize() / 4);
+    BoundsMinLongitude.reserve(BoundsMinLongitude.size() + File.GetSize() / 4);
+    BoundsMaxLongitude.reserve(BoundsMaxLongitude.size() + File.GetSize() / 4);
+    Populations.reserve(Populations.size() + File.GetSize() / 4);
 
-    for(int i = 0; i < NumberOfCountries; i++) {
-        if (pCountry[i].EquatorCheck == 1) {
-            std::cout << pCountry[i].NameOfCountry << " is on the equator" << std::endl;
+    for (long Line = 1; pPosition < pEnd; Line++)
+    {
+        // Blank lines, such as one left after the last row, are ignored
+        if (*pPosition == '\n' || (*pPosition == '\r' && (pPosition + 1 == pEnd || pPosition[1] == '\n')))
+        {
+            pPosition = (const char*)memchr(pPosition, '\n', pEnd - pPosition);
+            pPosition = pPosition != NULL ? pPosition + 1 : pEnd;
+            continue;
+        }
+
+        uint32_t NameStart = (uint32_t)NameArena.size();
+        const char* pFieldEnd = ParseField(pPosition, pEnd, true);
+
+        // "name,0" or "name,1", the attributes if there are any, then the end of the line
+        CCountry Country;
+        bool Valid = pFieldEnd != NULL && pFieldEnd + 1 < pEnd && *pFieldEnd == ',' && (pFieldEnd[1] == '0' || pFieldEnd[1] == '1');
+        const char* pLineEnd = Valid ? pFieldEnd + 2 : pFieldEnd;
+        if (Valid && pLineEnd < pEnd && *pLineEnd == ',')
+        {
+            pLineEnd = ParseAttributes(pLineEnd + 1, pEnd, Country);
+            Valid = pLineEnd != NULL;
+        }
+        if (Valid && pLineEnd < pEnd && *pLineEnd == '\r')
+        {
+            pLineEnd++;
+        }
+        Valid = Valid && (pLineEnd == pEnd || *pLineEnd == '\n');
+
+        if (!Valid)
+        {
+            NameArena.resize(NameStart);
+
+            // Only a first line whose equator field is not a number is a header
+            bool NumericEquator = pFieldEnd != NULL && pFieldEnd + 1 < pEnd && *pFieldEnd == ','
+                                  && ((pFieldEnd[1] >= '0' && pFieldEnd[1] <= '9') || pFieldEnd[1] == '-' || pFieldEnd[1] == '+');
+            if (Line == 1 && !NumericEquator)
+            {
+                const char* pNewLine = (const char*)memchr(pPosition, '\n', pEnd - pPosition);
+                pPosition = pNewLine != NULL ? pNewLine + 1 : pEnd;
+                continue;
+            }
+            Error = std::string(FileName) + " line " + std::to_string(Line)
+                  + " is not \"name,equator[,latitude,population,hemisphere,continent"
+                    "[,min_latitude,max_latitude,min_longitude,max_longitude]]\"";
+            return false;
+        }
+
+        Country.EquatorCheck = pFieldEnd[1] == '1';
+        AppendCountry(Country);
+
+        pPosition = pLineEnd < pEnd ? pLineEnd + 1 : pEnd;
+    }
+    return true;
+}
+
+// Returns the end of the last field, or NULL if one does not parse
+const char* CPlanet::ParseAttributes(const char* pPosition, const char* pEnd, CCountry& Country)
+{
+    const char* pFields[4];
+    const char* pFieldEnds[4];
+    for (int f = 0; f < 4; f++)
+    {
+        if (f > 0)
+        {
+            if (pPosition >= pEnd || *pPosition != ',')
+            {
+                return NULL;
+            }
+            pPosition++;
+        }
+        pFields[f] = pPosition;
+        pPosition = ParseField(pPosition, pEnd, false);
+        if (pPosition == NULL)
+        {
+            return NULL;
+        }
+        pFieldEnds[f] = pPosition;
+    }
+
+    std::from_chars_result Latitude = std::from_chars(pFields[0], pFieldEnds[0], Country.Latitude);
+    std::from_chars_result Population = std::from_chars(pFields[1], pFieldEnds[1], Country.Population);
+    Country.Hemisphere = CCountryQuery::FindHemisphere(std::string_view(pFields[2], pFieldEnds[2] - pFields[2]));
+    Country.Continent = CCountryQuery::FindContinent(std::string_view(pFields[3], pFieldEnds[3] - pFields[3]));
+
+    if (Latitude.ec != std::errc() || Latitude.ptr != pFieldEnds[0] || !(Country.Latitude >= -90 && Country.Latitude <= 90)
+        || Population.ec != std::errc() || Population.ptr != pFieldEnds[1] || Country.Hemisphere < 0 || Country.Continent < 0)
+    {
+        return NULL;
+    }
+
+    if (pPosition >= pEnd || *pPosition != ',')
+    {
+        return pPosition;
+    }
+
+    // The bounding box within the map, the latitudes min before max. A min
+    // longitude above the max is a box that crosses 180.
+    double* pBounds[4] = { &Country.MinLatitude, &Country.MaxLatitude, &Country.MinLongitude, &Country.MaxLongitude };
+    for (int b = 0; b < 4; b++)
+    {
+        if (pPosition >= pEnd || *pPosition != ',')
+        {
+            return NULL;
+        }
+        std::from_chars_result Bound = std::from_chars(pPosition + 1, pEnd, *pBounds[b]);
+        if (Bound.ec != std::errc())
+        {
+            return NULL;
+        }
+        pPosition = Bound.ptr;
+    }
+    if (!(Country.MinLatitude <= Country.MaxLatitude && Country.MinLatitude >= -90 && Country.MaxLatitude <= 90
+          && Country.MinLongitude >= -180 && Country.MinLongitude <= 180 && Country.MaxLongitude >= -180 && Country.MaxLongitude <= 180))
+    {
+        return NULL;
+    }
+    return pPosition;
+}
+
+// A quoted field may hold commas and "" for a quote
+const char* CPlanet::ParseField(const char* pField, const char* pEnd, bool Name)
+{
+    if (pField < pEnd && *pField == '"')
+    {
+        const char* pPosition = pField + 1;
+        while (pPosition < pEnd)
+        {
+            const char* pQuote = (const char*)memchr(pPosition, '"', pEnd - pPosition);
+            if (pQuote == NULL)
+            {
+                return NULL;
+            }
+            if (Name)
+            {
+                NameArena.append(pPosition, pQuote - pPosition);
+            }
+            if (pQuote + 1 < pEnd && pQuote[1] == '"')
+            {
+                if (Name)
+                {
+                    NameArena += '"';
+                }
+                pPosition = pQuote + 2;
+                continue;
+            }
+            return pQuote + 1;
+        }
+        return NULL;
+    }
+
+    const char* pPosition = pField;
+    while (pPosition < pEnd && *pPosition != ',' && *pPosition != '\n' && *pPosition != '\r')
+    {
+        pPosition++;
+    }
+    if (Name)
+    {
+        NameArena.append(pField, pPosition - pField);
+    }
+    return pPosition;
+}
+
+std::string_view CPlanet::GetCountryName(int Index) const
+{
+    return std::string_view(NameArena.data() + NameOffsets[Index], NameOffsets[Index + 1] - NameOffsets[Index]);
+}
+
+CCountry CPlanet::GetCountry(int Index) const
+{
+    CCountry Country;
+    Country.NameOfCountry = GetCountryName(Index);
+    Country.EquatorCheck = TestBit(EquatorBits, Index);
+    Country.Latitude = Latitudes[Index];
+    Country.Population = Populations[Index];
+    Country.MinLatitude = BoundsMinLatitude[Index];
+    Country.MaxLatitude = BoundsMaxLatitude[Index];
+    Country.MinLongitude = BoundsMinLongitude[Index];
+    Country.MaxLongitude = BoundsMaxLongitude[Index];
+    for (int h = 0; h < NUM_HEMISPHERES; h++)
+    {
+        Country.Hemisphere = TestBit(HemisphereBits[h], Index) ? h : Country.Hemisphere;
+    }
+    for (int c = 0; c < NUM_CONTINENTS; c++)
+    {
+        Country.Continent = TestBit(ContinentBits[c], Index) ? c : Country.Continent;
+    }
+    return Country;
+}
+
+int CPlanet::GetNumberOfCountries() const
+{
+    return NumberOfCountries;
+}
+
+int CPlanet::CountEquitorials() const
+{
+    int Count = 0;
+    for (size_t w = 0; w < EquatorBits.size(); w++)
+    {
+        Count += __builtin_popcountll(EquatorBits[w]);
+    }
+    return Count;
+}
+
+// Each step jumps straight to the next set bit and clears it
+void CPlanet::FindEquitorials(std::vector<int>& Indices) const
+{
+    Indices.clear();
+    for (size_t w = 0; w < EquatorBits.size(); w++)
+    {
+        for (uint64_t Word = EquatorBits[w]; Word != 0; Word &= Word - 1)
+        {
+            Indices.push_back((int)(w * 64 + __builtin_ctzll(Word)));
+        }
+    }
+}
+
+void CPlanet::ReportEquitorials(int Threads)
+{
+    std::string Output = "The Planets that are on the equator are: \n";
+    WriteEquitorials(Output, Threads);
+    std::cout.write(Output.data(), Output.size());
+    std::cout.flush();
+}
+
+// Small planets are not split up, starting a thread costs more than the scan
+void CPlanet::WriteEquitorials(std::string& Output, int Threads) const
+{
+    Threads = Threads > 0 ? Threads : (int)std::thread::hardware_concurrency();
+    size_t MostThreads = EquatorBits.size() / MinWordsPerReportThread;
+    Threads = Threads < (int)MostThreads ? Threads : (int)MostThreads;
+    if (Threads <= 1)
+    {
+        AppendEquitorials(0, EquatorBits.size(), &Output);
+        return;
+    }
+
+    std::vector<std::string> Buffers(Threads);
+    std::vector<std::thread> Workers;
+    size_t WordsPerThread = (EquatorBits.size() + Threads - 1) / Threads;
+    for (int t = 1; t < Threads; t++)
+    {
+        size_t FirstWord = t * WordsPerThread < EquatorBits.size() ? t * WordsPerThread : EquatorBits.size();
+        size_t LastWord = FirstWord + WordsPerThread < EquatorBits.size() ? FirstWord + WordsPerThread : EquatorBits.size();
+        Workers.push_back(std::thread(&CPlanet::AppendEquitorials, this, FirstWord, LastWord, &Buffers[t]));
+    }
+    AppendEquitorials(0, WordsPerThread, &Buffers[0]);
+
+    size_t Total = Output.size();
+    for (int t = 0; t < Threads; t++)
+    {
+        if (t > 0)
+        {
+            Workers[t - 1].join();
+        }
+        Total += Buffers[t].size();
+    }
+    Output.reserve(Total);
+    for (int t = 0; t < Threads; t++)
+    {
+        Output += Buffers[t];
+    }
+}
+
+void CPlanet::AppendEquitorials(size_t FirstWord, size_t LastWord, std::string* pOutput) const
+{
+    for (size_t w = FirstWord; w < LastWord; w++)
+    {
+        for (uint64_t Word = EquatorBits[w]; Word != 0; Word &= Word - 1)
+        {
+            std::string_view Name = GetCountryName((int)(w * 64 + __builtin_ctzll(Word)));
+            pOutput->append(Name.data(), Name.size());
+            *pOutput += " is on the equator\n";
+        }
+    }
+}
+
+void CPlanet::BuildIndexes()
+{
+    if (!IndexesDirty)
+    {
+        return;
+    }
+
+    ByLatitude.resize(NumberOfCountries);
+    std::iota(ByLatitude.begin(), ByLatitude.end(), 0);
+    std::sort(ByLatitude.begin(), ByLatitude.end(), [this](int a, int b) { return Latitudes[a] < Latitudes[b]; });
+
+    ByPopulation.resize(NumberOfCountries);
+    std::iota(ByPopulation.begin(), ByPopulation.end(), 0);
+    std::sort(ByPopulation.begin(), ByPopulation.end(), [this](int a, int b) { return Populations[a] < Populations[b]; });
+
+    IndexesDirty = false;
+}
+
+void CPlanet::RunQuery(const CCountryQuery& Query, std::vector<uint64_t>& Matches)
+{
+    BuildIndexes();
+
+    // Start with every country, the unused bits of the last word cleared
+    size_t Words = EquatorBits.size();
+    Matches.assign(Words, ~0ull);
+    if (NumberOfCountries % 64 != 0)
+    {
+        Matches.back() = (1ull << (NumberOfCountries % 64)) - 1;
+    }
+
+    for (size_t w = 0; w < Words; w++)
+    {
+        if (Query.Equator >= 0)
+        {
+            Matches[w] &= Query.Equator == 1 ? EquatorBits[w] : ~EquatorBits[w];
+        }
+        if (Query.Hemisphere >= 0)
+        {
+            Matches[w] &= HemisphereBits[Query.Hemisphere][w];
+        }
+        if (Query.ContinentMask != 0)
+        {
+            uint64_t AnyContinent = 0;
+            for (int c = 0; c < NUM_CONTINENTS; c++)
+            {
+                AnyContinent |= (Query.ContinentMask >> c) & 1 ? ContinentBits[c][w] : 0;
+            }
+            Matches[w] &= AnyContinent;
+        }
+    }
+
+    if (Query.HasLatitude)
+    {
+        // The column holds floats, so the bounds are rounded the same way or "lat=0.1:0.1" would miss 0.1
+        AndRange(ByLatitude, Latitudes, (float)Query.MinLatitude, (float)Query.MaxLatitude, Matches);
+    }
+    if (Query.HasPopulation)
+    {
+        AndRange(ByPopulation, Populations, Query.MinPopulation, Query.MaxPopulation, Matches);
+    }
+}
+
+// The countries in range are one slice of the sorted index, found by two binary searches
+template <class TColumn, class TValue>
+void CPlanet::AndRange(const std::vector<int>& Sorted, const std::vector<TColumn>& Column, TValue Min, TValue Max,
+                       std::vector<uint64_t>& Matches)
+{
+    std::vector<int>::const_iterator First = std::partition_point(Sorted.begin(), Sorted.end(),
+        [&Column, Min](int i) { return Column[i] < Min; });
+    std::vector<int>::const_iterator Last = std::partition_point(First, Sorted.end(),
+        [&Column, Max](int i) { return Column[i] <= Max; });
+
+    std::vector<uint64_t> InRange(Matches.size(), 0);
+    for (std::vector<int>::const_iterator i = First; i != Last; ++i)
+    {
+        InRange[*i / 64] |= 1ull << (*i % 64);
+    }
+    for (size_t w = 0; w < Matches.size(); w++)
+    {
+        Matches[w] &= InRange[w];
+    }
+}
+
+int CPlanet::CountQuery(const CCountryQuery& Query)
+{
+    std::vector<uint64_t> Matches;
+    RunQuery(Query, Matches);
+
+    int Count = 0;
+    for (size_t w = 0; w < Matches.size(); w++)
+    {
+        Count += __builtin_popcountll(Matches[w]);
+    }
+    return Count;
+}
+
+void CPlanet::FindQuery(const CCountryQuery& Query, std::vector<int>& Indices)
+{
+    std::vector<uint64_t> Matches;
+    RunQuery(Query, Matches);
+
+    Indices.clear();
+    for (size_t w = 0; w < Matches.size(); w++)
+    {
+        for (uint64_t Word = Matches[w]; Word != 0; Word &= Word - 1)
+        {
+            Indices.push_back((int)(w * 64 + __builtin_ctzll(Word)));
         }
     }
 }
 
 CCountry::CCountry()
 {
-    std::cout << "What is the name of the country: ";
-    std::cin >> NameOfCountry;
+    EquatorCheck = false;
+    Latitude = 0;
+    Population = 0;
+    Hemisphere = HEMISPHERE_NORTH;
+    Continent = CONTINENT_UNKNOWN;
+    MinLatitude = NAN;
+    MaxLatitude = NAN;
+    MinLongitude = NAN;
+    MaxLongitude = NAN;
+}
 
-    std::cout << "Enter a 1 or a 0 if the country lies on the equator: ";
-    std::cin >> EquatorCheck;
+bool CCountry::HasBounds() const
+{
+    return !std::isnan(MinLatitude);
+}
 
-    std::cout << "Country " << NameOfCountry << " created." << std::endl;
+CCountryQuery::CCountryQuery()
+{
+    ContinentMask = 0;
+    Hemisphere = -1;
+    Equator = -1;
+    HasLatitude = false;
+    MinLatitude = -90;
+    MaxLatitude = 90;
+    HasPopulation = false;
+    MinPopulation = 0;
+    MaxPopulation = UINT64_MAX;
 }
 
-CCountry::~CCountry()
+template <class TValue>
+static bool ParseWhole(const char* pBegin, const char* pEnd, TValue& Value)
 {
-    std::cout << NameOfCountry << " Dtor." << std::endl; 
+    std::from_chars_result Result = std::from_chars(pBegin, pEnd, Value);
+    return Result.ec == std::errc() && Result.ptr == pEnd;
 }
 
+bool CCountryQuery::ParseCondition(const char* Condition)
+{
+    const char* pEquals = strchr(Condition, '=');
+    if (pEquals == NULL)
+    {
+        return false;
+    }
+    std::string_view Key(Condition, pEquals - Condition);
+    const char* pValue = pEquals + 1;
 
+    if (Key == "continent")
+    {
+        int Continent = FindContinent(pValue);
+        ContinentMask |= Continent >= 0 ? 1u << Continent : 0;
+        return Continent >= 0;
+    }
+    if (Key == "hemisphere")
+    {
+        Hemisphere = FindHemisphere(pValue);
+        return Hemisphere >= 0;
+    }
+    if (Key == "equator")
+    {
+        if (strcmp(pValue, "0") != 0 && strcmp(pValue, "1") != 0)
+        {
+            return false;
+        }
+        Equator = *pValue == '1';
+        return true;
+    }
 
+    const char* pColon = strchr(pValue, ':');
+    if (pColon == NULL || (Key != "lat" && Key != "pop"))
+    {
+        return false;
+    }
+    const char* pEnd = pColon + strlen(pColon);
+    if (Key == "lat")
+    {
+        double Min = -90;
+        double Max = 90;
+        if ((pColon > pValue && !ParseWhole(pValue, pColon, Min)) || (pColon + 1 < pEnd && !ParseWhole(pColon + 1, pEnd, Max))
+            || !(Min >= -90 && Max <= 90 && Min <= Max))
+        {
+            return false;
+        }
+        HasLatitude = true;
+        MinLatitude = Min;
+        MaxLatitude = Max;
+        return true;
+    }
+    uint64_t Min = 0;
+    uint64_t Max = UINT64_MAX;
+    if ((pColon > pValue && !ParseWhole(pValue, pColon, Min)) || (pColon + 1 < pEnd && !ParseWhole(pColon + 1, pEnd, Max)))
+    {
+        return false;
+    }
+    HasPopulation = true;
+    MinPopulation = Min;
+    MaxPopulation = Max;
+    return true;
+}
 
+// Compares letters only, case-blind, so "north america", "NorthAmerica" and "North_America" all match
+static bool SameName(std::string_view Name, const char* Expected)
+{
+    size_t i = 0;
+    for (const char* p = Expected; ; p++)
+    {
+        while (i < Name.size() && !isalpha((unsigned char)Name[i]))
+        {
+            i++;
+        }
+        while (*p != '\0' && !isalpha((unsigned char)*p))
+        {
+            p++;
+        }
+        if (*p == '\0' || i == Name.size())
+        {
+            return *p == '\0' && i == Name.size();
+        }
+        if (tolower((unsigned char)Name[i]) != tolower((unsigned char)*p))
+        {
+            return false;
+        }
+        i++;
+    }
+}
 
+int CCountryQuery::FindContinent(std::string_view Name)
+{
+    for (int c = 0; c < NUM_CONTINENTS; c++)
+    {
+        if (SameName(Name, ContinentNames[c]))
+        {
+            return c;
+        }
+    }
+    return -1;
+}
 
+int CCountryQuery::FindHemisphere(std::string_view Name)
+{
+    if (Name == "N" || Name == "n")
+    {
+        return HEMISPHERE_NORTH;
+    }
+    if (Name == "S" || Name == "s")
+    {
+        return HEMISPHERE_SOUTH;
+    }
+    for (int h = 0; h < NUM_HEMISPHERES; h++)
+    {
+        if (SameName(Name, HemisphereNames[h]))
+        {
+            return h;
+        }
+    }
+    return -1;
+}
 
+bool ReportBand(const char* FileName, double MinLatitude, double MaxLatitude)
+{
+    CPlanet Planet(FileName);
+    std::string Error;
+    if (!Planet.LoadCountries(FileName, Error))
+    {
+        std::cout << Error << std::endl;
+        return false;
+    }
 
+    std::vector<int> Indices;
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    Planet.FindInLatitudeBand(MinLatitude, MaxLatitude, Indices);
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
 
+    std::cout << Indices.size() << " of " << Planet.GetNumberOfCountries() << " countries touch latitudes " << MinLatitude
+              << " to " << MaxLatitude << ", found in " << Elapsed.count() * 1e3 << " ms\n";
+    for (size_t i = 0; i < Indices.size() && i < (size_t)MaxListedMatches; i++)
+    {
+        CCountry Country = Planet.GetCountry(Indices[i]);
+        std::cout << "  " << Country.NameOfCountry << ": latitudes " << Country.MinLatitude << " to " << Country.MaxLatitude << "\n";
+    }
+    std::cout << std::flush;
+    return true;
+}
+
+bool ReportNearest(const char* FileName, double Latitude, double Longitude)
+{
+    CPlanet Planet(FileName);
+    std::string Error;
+    if (!Planet.LoadCountries(FileName, Error))
+    {
+        std::cout << Error << std::endl;
+        return false;
+    }
+
+    double Distance = 0;
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    int Nearest = Planet.FindNearest(Latitude, Longitude, &Distance);
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+
+    if (Nearest < 0)
+    {
+        std::cout << "No country in " << FileName << " has a bounding box" << std::endl;
+        return false;
+    }
+
+    CCountry Country = Planet.GetCountry(Nearest);
+    std::cout << "Nearest to " << Latitude << ", " << Longitude << " is " << Country.NameOfCountry << " (latitudes "
+              << Country.MinLatitude << " to " << Country.MaxLatitude << ", longitudes " << Country.MinLongitude << " to "
+              << Country.MaxLongitude << "), " << Distance << " degrees away, found in " << Elapsed.count() * 1e3 << " ms" << std::endl;
+    return true;
+}
+
+bool ReportQuery(const char* FileName, int NumberOfConditions, char* Conditions[])
+{
+    CCountryQuery Query;
+    for (int i = 0; i < NumberOfConditions; i++)
+    {
+        if (!Query.ParseCondition(Conditions[i]))
+        {
+            std::cout << "Cannot read condition " << Conditions[i] << std::endl;
+            return false;
+        }
+    }
+
+    CPlanet Planet(FileName);
+    std::string Error;
+    if (!Planet.LoadCountries(FileName, Error))
+    {
+        std::cout << Error << std::endl;
+        return false;
+    }
+
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    Planet.BuildIndexes();
+    std::chrono::steady_clock::time_point Indexed = std::chrono::steady_clock::now();
+    std::vector<int> Indices;
+    Planet.FindQuery(Query, Indices);
+    std::chrono::steady_clock::time_point Queried = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> IndexTime = Indexed - Start;
+    std::chrono::duration<double> QueryTime = Queried - Indexed;
+    std::cout << Indices.size() << " of " << Planet.GetNumberOfCountries() << " countries match, query " << QueryTime.count() * 1e3
+              << " ms (indexes built once in " << IndexTime.count() * 1e3 << " ms)\n";
+    for (size_t i = 0; i < Indices.size() && i < (size_t)MaxListedMatches; i++)
+    {
+        CCountry Country = Planet.GetCountry(Indices[i]);
+        std::cout << "  " << Country.NameOfCountry << ": latitude " << Country.Latitude << ", population " << Country.Population
+                  << ", " << HemisphereNames[Country.Hemisphere] << ", " << ContinentNames[Country.Continent]
+                  << (Country.EquatorCheck ? ", on the equator" : "") << "\n";
+    }
+    std::cout << std::flush;
+    return true;
+}
+
+bool CTrace::Enabled = false;
+std::string CTrace::Buffer;
+
+// The buffer is flushed at exit, after main's own objects are destroyed
+void CTrace::Enable(bool On)
+{
+    if (On && !Enabled)
+    {
+        Buffer.reserve(TraceBufferBytes);
+        atexit(Flush);
+    }
+    Enabled = On;
+}
+
+bool CTrace::IsEnabled()
+{
+    return Enabled;
+}
+
+void CTrace::Write(std::string_view Line)
+{
+    Buffer.append(Line.data(), Line.size());
+    Buffer += '\n';
+    if (Buffer.size() >= TraceBufferBytes)
+    {
+        Flush();
+    }
+}
+
+void CTrace::Flush()
+{
+    std::cout.write(Buffer.data(), Buffer.size());
+    std::cout.flush();
+    Buffer.clear();
+}
+
+CMappedFile::CMappedFile()
+{
+    pData = NULL;
+    Size = 0;
+}
+
+CMappedFile::~CMappedFile()
+{
+    Close();
+}
+
+bool CMappedFile::Open(const char* FileName)
+{
+    Close();
+
+    int Descriptor = open(FileName, O_RDONLY);
+    if (Descriptor < 0)
+    {
+        return false;
+    }
+
+    struct stat FileStat;
+    if (fstat(Descriptor, &FileStat) != 0)
+    {
+        close(Descriptor);
+        return false;
+    }
+
+    // An empty file cannot be mapped but is still a valid, empty view
+    Size = (size_t)FileStat.st_size;
+    if (Size > 0)
+    {
+        void* pMapping = mmap(NULL, Size, PROT_READ, MAP_PRIVATE, Descriptor, 0);
+        if (pMapping == MAP_FAILED)
+        {
+            close(Descriptor);
+            Size = 0;
+            return false;
+        }
+        madvise(pMapping, Size, MADV_SEQUENTIAL);
+        pData = (const char*)pMapping;
+    }
+    close(Descriptor);
+    return true;
+}
+
+void CMappedFile::Close()
+{
+    if (pData != NULL)
+    {
+        munmap((void*)pData, Size);
+    }
+    pData = NULL;
+    Size = 0;
+}
+
+const char* CMappedFile::GetData() const
+{
+    return pData;
+}
+
+size_t CMappedFile::GetSize() const
+{
+    return Size;
+}
+
+CPlanetCatalog::CPlanetCatalog()
+{
+    pEntries = NULL;
+    NumberOfPlanets = 0;
+}
+
+uint64_t CPlanetCatalog::SectionSize(int Section, uint64_t Countries, uint64_t NamesSize)
+{
+    uint64_t Words = (Countries + 63) / 64;
+    switch (Section)
+    {
+        case SECTION_NAME_OFFSETS:  return (Countries + 1) * sizeof(uint32_t);
+        case SECTION_NAMES:         return NamesSize;
+        case SECTION_EQUATOR:       return Words * sizeof(uint64_t);
+        case SECTION_HEMISPHERES:   return NUM_HEMISPHERES * Words * sizeof(uint64_t);
+        case SECTION_CONTINENTS:    return NUM_CONTINENTS * Words * sizeof(uint64_t);
+        case SECTION_LATITUDES:     return Countries * sizeof(float);
+        case SECTION_POPULATIONS:   return Countries * sizeof(uint64_t);
+        case SECTION_BOUNDS:        return 4 * Countries * sizeof(float);
+    }
+    return 0;
+}
+
+uint64_t CPlanetCatalog::WriteSection(std::ofstream& File, const void* pData, uint64_t Size)
+{
+    static const char Padding[8] = { 0 };
+    uint64_t Offset = (uint64_t)File.tellp();
+    File.write((const char*)pData, Size);
+    File.write(Padding, (8 - Size % 8) % 8);
+    return Offset;
+}
+
+bool CPlanetCatalog::Save(const char* FileName, const std::vector<CPlanet*>& Planets, std::string& Error)
+{
+    std::ofstream File(FileName, std::ios::binary);
+    if (!File)
+    {
+        Error = std::string("Cannot write ") + FileName;
+        return false;
+    }
+
+    Header CatalogHeader;
+    memset(&CatalogHeader, 0, sizeof(CatalogHeader));
+    File.write((const char*)&CatalogHeader, sizeof(CatalogHeader));
+
+    std::vector<PlanetEntry> Entries(Planets.size());
+    for (size_t p = 0; p < Planets.size(); p++)
+    {
+        const CPlanet& Planet = *Planets[p];
+        PlanetEntry& Entry = Entries[p];
+        uint64_t Countries = Planet.NumberOfCountries;
+        uint64_t Words = Planet.EquatorBits.size();
+
+        Entry.NameLength = Planet.m_PlanetName.size();
+        Entry.NameOffset = WriteSection(File, Planet.m_PlanetName.data(), Entry.NameLength);
+        Entry.NumberOfCountries = Countries;
+        Entry.NamesSize = Planet.NameArena.size();
+
+        Entry.Sections[SECTION_NAME_OFFSETS] = WriteSection(File, Planet.NameOffsets.data(), (Countries + 1) * sizeof(uint32_t));
+        Entry.Sections[SECTION_NAMES] = WriteSection(File, Planet.NameArena.data(), Entry.NamesSize);
+        Entry.Sections[SECTION_EQUATOR] = WriteSection(File, Planet.EquatorBits.data(), Words * sizeof(uint64_t));
+
+        // Several bitmaps or columns in a row make one section
+        for (int h = 0; h < NUM_HEMISPHERES; h++)
+        {
+            uint64_t Offset = WriteSection(File, Planet.HemisphereBits[h].data(), Words * sizeof(uint64_t));
+            Entry.Sections[SECTION_HEMISPHERES] = h == 0 ? Offset : Entry.Sections[SECTION_HEMISPHERES];
+        }
+        for (int c = 0; c < NUM_CONTINENTS; c++)
+        {
+            uint64_t Offset = WriteSection(File, Planet.ContinentBits[c].data(), Words * sizeof(uint64_t));
+            Entry.Sections[SECTION_CONTINENTS] = c == 0 ? Offset : Entry.Sections[SECTION_CONTINENTS];
+        }
+        Entry.Sections[SECTION_LATITUDES] = WriteSection(File, Planet.Latitudes.data(), Countries * sizeof(float));
+        Entry.Sections[SECTION_POPULATIONS] = WriteSection(File, Planet.Populations.data(), Countries * sizeof(uint64_t));
+
+        // Float columns pad to 8 bytes, so the four bounds columns are written as one block
+        std::vector<float> Bounds;
+        Bounds.reserve(4 * Countries);
+        Bounds.insert(Bounds.end(), Planet.BoundsMinLatitude.begin(), Planet.BoundsMinLatitude.end());
+        Bounds.insert(Bounds.end(), Planet.BoundsMaxLatitude.begin(), Planet.BoundsMaxLatitude.end());
+        Bounds.insert(Bounds.end(), Planet.BoundsMinLongitude.begin(), Planet.BoundsMinLongitude.end());
+        Bounds.insert(Bounds.end(), Planet.BoundsMaxLongitude.begin(), Planet.BoundsMaxLongitude.end());
+        Entry.Sections[SECTION_BOUNDS] = WriteSection(File, Bounds.data(), Bounds.size() * sizeof(float));
+    }
+
+    memcpy(CatalogHeader.Magic, CatalogMagic, sizeof(CatalogMagic));
+    CatalogHeader.Version = CatalogVersion;
+    CatalogHeader.NumberOfPlanets = (uint32_t)Planets.size();
+    CatalogHeader.DirectoryOffset = WriteSection(File, Entries.data(), Entries.size() * sizeof(PlanetEntry));
+    File.seekp(0);
+    File.write((const char*)&CatalogHeader, sizeof(CatalogHeader));
+
+    if (!File)
+    {
+        Error = std::string("Cannot write ") + FileName;
+        return false;
+    }
+    return true;
+}
+
+// Checks that everything the directory points at lies inside the file
+bool CPlanetCatalog::Open(const char* FileName, std::string& Error)
+{
+    pEntries = NULL;
+    NumberOfPlanets = 0;
+    if (!File.Open(FileName))
+    {
+        Error = std::string("Cannot open ") + FileName;
+        return false;
+    }
+
+    Error = std::string(FileName) + " is not a planet catalog";
+    uint64_t Size = File.GetSize();
+    if (Size < sizeof(Header))
+    {
+        return false;
+    }
+    const Header* pHeader = (const Header*)File.GetData();
+    if (memcmp(pHeader->Magic, CatalogMagic, sizeof(CatalogMagic)) != 0 || pHeader->Version != CatalogVersion
+        || pHeader->DirectoryOffset % 8 != 0 || pHeader->DirectoryOffset > Size
+        || (Size - pHeader->DirectoryOffset) / sizeof(PlanetEntry) < pHeader->NumberOfPlanets)
+    {
+        return false;
+    }
+
+    const PlanetEntry* pDirectory = (const PlanetEntry*)(File.GetData() + pHeader->DirectoryOffset);
+    for (uint32_t p = 0; p < pHeader->NumberOfPlanets; p++)
+    {
+        const PlanetEntry& Entry = pDirectory[p];
+        if (Entry.NameOffset > Size || Entry.NameLength > Size - Entry.NameOffset || Entry.NumberOfCountries > (uint64_t)INT32_MAX)
+        {
+            return false;
+        }
+        for (int Section = 0; Section < NUM_CATALOG_SECTIONS; Section++)
+        {
+            uint64_t SectionBytes = SectionSize(Section, Entry.NumberOfCountries, Entry.NamesSize);
+            if (Entry.Sections[Section] % 8 != 0 || Entry.Sections[Section] > Size || SectionBytes > Size - Entry.Sections[Section])
+            {
+                return false;
+            }
+        }
+    }
+
+    Error.clear();
+    pEntries = pDirectory;
+    NumberOfPlanets = (int)pHeader->NumberOfPlanets;
+    return true;
+}
+
+template <class T>
+const T* CPlanetCatalog::GetSection(int Planet, int Section) const
+{
+    return (const T*)(File.GetData() + pEntries[Planet].Sections[Section]);
+}
+
+int CPlanetCatalog::GetNumberOfPlanets() const
+{
+    return NumberOfPlanets;
+}
+
+std::string_view CPlanetCatalog::GetPlanetName(int Planet) const
+{
+    return std::string_view(File.GetData() + pEntries[Planet].NameOffset, pEntries[Planet].NameLength);
+}
+
+int CPlanetCatalog::FindPlanet(std::string_view Name) const
+{
+    for (int p = 0; p < NumberOfPlanets; p++)
+    {
+        if (GetPlanetName(p) == Name)
+        {
+            return p;
+        }
+    }
+    return -1;
+}
+
+int CPlanetCatalog::GetNumberOfCountries(int Planet) const
+{
+    return (int)pEntries[Planet].NumberOfCountries;
+}
+
+// Offsets are not checked on open, that would read every country, so a bad pair gives an empty name instead
+std::string_view CPlanetCatalog::GetCountryName(int Planet, int Country) const
+{
+    const uint32_t* pOffsets = GetSection<uint32_t>(Planet, SECTION_NAME_OFFSETS);
+    uint32_t Start = pOffsets[Country];
+    uint32_t End = pOffsets[Country + 1];
+    if (Start > End || End > pEntries[Planet].NamesSize)
+    {
+        return std::string_view();
+    }
+    return std::string_view(GetSection<char>(Planet, SECTION_NAMES) + Start, End - Start);
+}
+
+int CPlanetCatalog::CountEquitorials(int Planet) const
+{
+    const uint64_t* pBits = GetSection<uint64_t>(Planet, SECTION_EQUATOR);
+    uint64_t Words = (pEntries[Planet].NumberOfCountries + 63) / 64;
+
+    int Count = 0;
+    for (uint64_t w = 0; w < Words; w++)
+    {
+        Count += __builtin_popcountll(pBits[w]);
+    }
+    return Count;
+}
+
+void CPlanetCatalog::ReportEquitorials(int Planet, std::string& Output) const
+{
+    const uint64_t* pBits = GetSection<uint64_t>(Planet, SECTION_EQUATOR);
+    uint64_t Words = (pEntries[Planet].NumberOfCountries + 63) / 64;
+
+    for (uint64_t w = 0; w < Words; w++)
+    {
+        for (uint64_t Word = pBits[w]; Word != 0; Word &= Word - 1)
+        {
+            std::string_view Name = GetCountryName(Planet, (int)(w * 64 + __builtin_ctzll(Word)));
+            Output.append(Name.data(), Name.size());
+            Output += " is on the equator\n";
+        }
+    }
+}
+
+bool BuildCatalog(const char* CatalogName, int NumberOfFiles, char* FileNames[])
+{
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    std::vector<CPlanet*> Planets;
+    bool Loaded = true;
+    for (int f = 0; f < NumberOfFiles && Loaded; f++)
+    {
+        // The planet is named after the file, without its folder or extension
+        std::string Name = FileNames[f];
+        size_t Slash = Name.find_last_of('/');
+        Name = Slash == std::string::npos ? Name : Name.substr(Slash + 1);
+        Name = Name.substr(0, Name.find_last_of('.'));
+
+        std::string Error;
+        Planets.push_back(new CPlanet(Name));
+        Loaded = Planets.back()->LoadCountries(FileNames[f], Error);
+        if (!Loaded)
+        {
+            std::cout << Error << std::endl;
+        }
+    }
+
+    std::string Error;
+    bool Saved = Loaded && CPlanetCatalog::Save(CatalogName, Planets, Error);
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+    if (Loaded && !Saved)
+    {
+        std::cout << Error << std::endl;
+    }
+    else if (Saved)
+    {
+        struct stat FileStat;
+        double Megabytes = stat(CatalogName, &FileStat) == 0 ? FileStat.st_size / 1e6 : 0;
+        std::cerr << "Saved " << Planets.size() << " planets to " << CatalogName << " (" << Megabytes << " MB) in "
+                  << Elapsed.count() << " s" << std::endl;
+    }
+
+    for (size_t p = 0; p < Planets.size(); p++)
+    {
+        delete Planets[p];
+    }
+    return Saved;
+}
+
+bool ReportCatalog(const char* CatalogName, const char* PlanetName)
+{
+    CPlanetCatalog Catalog;
+    std::string Error;
+
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    if (!Catalog.Open(CatalogName, Error))
+    {
+        std::cout << Error << std::endl;
+        return false;
+    }
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+    std::cerr << "Opened " << CatalogName << " with " << Catalog.GetNumberOfPlanets() << " planets in " << Elapsed.count() * 1e3
+              << " ms" << std::endl;
+
+    std::string Output;
+    if (PlanetName == NULL)
+    {
+        for (int p = 0; p < Catalog.GetNumberOfPlanets(); p++)
+        {
+            Output.append(Catalog.GetPlanetName(p));
+            Output += ": " + std::to_string(Catalog.GetNumberOfCountries(p)) + " countries, "
+                    + std::to_string(Catalog.CountEquitorials(p)) + " on the equator\n";
+        }
+    }
+    else
+    {
+        int Planet = Catalog.FindPlanet(PlanetName);
+        if (Planet < 0)
+        {
+            std::cout << "No planet " << PlanetName << " in " << CatalogName << std::endl;
+            return false;
+        }
+        Output = "The Planets that are on the equator are: \n";
+        Catalog.ReportEquitorials(Planet, Output);
+    }
+    std::cout << Output << std::flush;
+    return true;
+}
+
+bool GenerateCountries(long Countries, const char* FileName)
+{
+    std::ofstream File(FileName, std::ios::binary);
+    if (!File)
+    {
+        std::cout << "Cannot write " << FileName << std::endl;
+        return false;
+    }
+
+    // Equatorial countries get a latitude near 0, the rest anywhere from Cape Horn to Svalbard
+    std::string Block = "name,equator,latitude,population,hemisphere,continent,min_latitude,max_latitude,min_longitude,max_longitude\n";
+    uint32_t State = 12345;
+    for (long i = 0; i < Countries; i++)
+    {
+        State = State * 1664525 + 1013904223;
+        bool OnEquator = (State >> 16) % EquatorOneIn == 0;
+        State = State * 1664525 + 1013904223;
+        double Latitude = OnEquator ? (State >> 8) / 16777216.0 * 10 - 5 : (State >> 8) / 16777216.0 * 135 - 56;
+        Latitude = round(Latitude * 100) / 100;
+        State = State * 1664525 + 1013904223;
+        uint64_t Population = (uint64_t)pow(10.0, 3 + (State >> 8) / 16777216.0 * 6);
+        State = State * 1664525 + 1013904223;
+        int Continent = (State >> 16) % CONTINENT_UNKNOWN;
+
+        // A box up to 8 degrees across around the latitude, equatorial ones stretched to cross the equator
+        State = State * 1664525 + 1013904223;
+        double HalfHeight = OnEquator ? fabs(Latitude) + 0.5 : 0.05 + (State >> 8) / 16777216.0 * 4;
+        State = State * 1664525 + 1013904223;
+        double HalfWidth = 0.05 + (State >> 8) / 16777216.0 * 4;
+        State = State * 1664525 + 1013904223;
+        double Longitude = (State >> 8) / 16777216.0 * (360 - 2 * HalfWidth) - 180 + HalfWidth;
+
+        char Attributes[64];
+        snprintf(Attributes, sizeof(Attributes), ",%.2f,%llu,%s,", Latitude, (unsigned long long)Population,
+                 Latitude < 0 ? "S" : "N");
+        char Bounds[96];
+        snprintf(Bounds, sizeof(Bounds), ",%.2f,%.2f,%.2f,%.2f\n", fmax(Latitude - HalfHeight, -90.0), fmin(Latitude + HalfHeight, 90.0),
+                 Longitude - HalfWidth, Longitude + HalfWidth);
+        Block += "Country" + std::to_string(i) + (OnEquator ? ",1" : ",0") + Attributes + ContinentNames[Continent] + Bounds;
+
+        if (Block.size() > (1 << 16))
+        {
+            File << Block;
+            Block.clear();
+        }
+    }
+    File << Block;
+    return true;
+}
+
+void BenchmarkEquitorials(long Countries)
+{
+    struct CObjectCountry
+    {
+        std::string NameOfCountry;
+        bool EquatorCheck;
+    };
+
+    CPlanet Planet("Benchmark");
+    std::vector<CObjectCountry> Objects(Countries);
+    uint32_t State = 12345;
+    for (long i = 0; i < Countries; i++)
+    {
+        State = State * 1664525 + 1013904223;
+        bool OnEquator = (State >> 16) % EquatorOneIn == 0;
+        std::string Name = "Country" + std::to_string(i);
+
+        Planet.AddCountry(Name, OnEquator);
+        Objects[i].NameOfCountry = Name;
+        Objects[i].EquatorCheck = OnEquator;
+    }
+
+    // Each query is run BenchmarkRepeats times and the name lengths of the
+    // matches are summed, so neither version can skip the work
+    std::vector<int> Indices;
+    long ObjectCount = 0;
+    long ObjectNameBytes = 0;
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    for (int r = 0; r < BenchmarkRepeats; r++)
+    {
+        for (long i = 0; i < Countries; i++)
+        {
+            ObjectCount += Objects[i].EquatorCheck;
+        }
+    }
+    std::chrono::steady_clock::time_point Counted = std::chrono::steady_clock::now();
+    for (int r = 0; r < BenchmarkRepeats; r++)
+    {
+        for (long i = 0; i < Countries; i++)
+        {
+            if (Objects[i].EquatorCheck)
+            {
+                ObjectNameBytes += Objects[i].NameOfCountry.size();
+            }
+        }
+    }
+    std::chrono::steady_clock::time_point Listed = std::chrono::steady_clock::now();
+    std::chrono::duration<double> ObjectCountTime = Counted - Start;
+    std::chrono::duration<double> ObjectListTime = Listed - Counted;
+
+    long BitCount = 0;
+    long BitNameBytes = 0;
+    Start = std::chrono::steady_clock::now();
+    for (int r = 0; r < BenchmarkRepeats; r++)
+    {
+        BitCount += Planet.CountEquitorials();
+    }
+    Counted = std::chrono::steady_clock::now();
+    for (int r = 0; r < BenchmarkRepeats; r++)
+    {
+        Planet.FindEquitorials(Indices);
+        for (size_t i = 0; i < Indices.size(); i++)
+        {
+            BitNameBytes += Planet.GetCountryName(Indices[i]).size();
+        }
+    }
+    Listed = std::chrono::steady_clock::now();
+    std::chrono::duration<double> BitCountTime = Counted - Start;
+    std::chrono::duration<double> BitListTime = Listed - Counted;
+
+    std::cout << Countries << " countries, " << BitCount / BenchmarkRepeats << " on the equator"
+              << (BitCount == ObjectCount && BitNameBytes == ObjectNameBytes ? "" : " (RESULTS DIFFER)") << "\n";
+    std::cout << "Count: objects " << ObjectCountTime.count() / BenchmarkRepeats * 1e3 << " ms, bitset "
+              << BitCountTime.count() / BenchmarkRepeats * 1e3 << " ms (" << ObjectCountTime.count() / BitCountTime.count() << "x)\n";
+    std::cout << "List:  objects " << ObjectListTime.count() / BenchmarkRepeats * 1e3 << " ms, bitset "
+              << BitListTime.count() / BenchmarkRepeats * 1e3 << " ms (" << ObjectListTime.count() / BitListTime.count() << "x)" << std::endl;
+}
+
+bool BenchmarkReport(const char* FileName, int MaxThreads)
+{
+    CPlanet Planet("Benchmark");
+    std::string Error;
+    if (!Planet.LoadCountries(FileName, Error))
+    {
+        std::cout << Error << std::endl;
+        return false;
+    }
+
+    // Every thread count must give the same bytes as one thread
+    std::string Expected;
+    Planet.WriteEquitorials(Expected, 1);
+    std::cout << Planet.GetNumberOfCountries() << " countries, " << Planet.CountEquitorials() << " on the equator, "
+              << Expected.size() / 1e6 << " MB of report, " << std::thread::hardware_concurrency() << " cores\n";
+
+    double SingleTime = 0;
+    for (int Threads = 1; Threads <= MaxThreads; Threads = Threads < MaxThreads && Threads * 2 > MaxThreads ? MaxThreads : Threads * 2)
+    {
+        std::string Output;
+        std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+        for (int r = 0; r < BenchmarkRepeats; r++)
+        {
+            Output.clear();
+            Planet.WriteEquitorials(Output, Threads);
+        }
+        std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+        SingleTime = Threads == 1 ? Elapsed.count() : SingleTime;
+
+        std::cout << Threads << " threads: " << Elapsed.count() / BenchmarkRepeats * 1e3 << " ms ("
+                  << SingleTime / Elapsed.count() << "x)" << (Output == Expected ? "" : " (RESULTS DIFFER)") << "\n";
+        if (Threads == MaxThreads)
+        {
+            break;
+        }
+    }
+    std::cout << std::flush;
+    return true;
+}
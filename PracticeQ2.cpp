@@ -1,27 +1,64 @@
 //--Includes-------------------------------------------------------------------
 #include <iostream>
 #include <string>
-#include <sstream>
+#include <vector>
+#include <variant>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <charconv>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <new>
+#include <string_view>
+#include <unordered_map>
 
 //--Consts, enums and lists----------------------------------------------------
+enum eSpeakerId { SPEAKER_ENGLISH, SPEAKER_FRENCH, SPEAKER_ITALIAN, SPEAKER_ADVANCED_ENGLISH, NUM_SPEAKER_IDS };
+
+const char* const SpeakerNames[NUM_SPEAKER_IDS] = { "English Speaker", "French Speaker", "Italian Speaker", "Advanced English Speaker" };
+const char* const SpeakerGreetings[NUM_SPEAKER_IDS] = { "Hello World.", "Bonjour World.", "Ciao World.", "My name is Ari" };
+
+const long DefaultBenchmarkSpeakers = 4000000;
+const long DefaultMetricsSpeakers = 1000000;
+const int DefaultMetricsRounds = 40;
+const int MetricsIntervalMs = 250;                                          // Time between snapshots while threads greet
+const int CacheLineSize = 64;
+const int SpeakerPoolBlockSize = 4096;                                      // Speakers per block a pool allocates
+const long DefaultServeRequests = 100;
+const long DefaultServeSpeakers = 100000;
+const long DefaultCatalogBenchLanguages = 100000;
+const int CatalogBenchGreetings = 97;                                       // Distinct greetings shared by the synthetic languages
 
 //---Forward Declarations------------------------------------------------------
 
 class CSpeaker;
 
 //---Interface-----------------------------------------------------------------
+// Greetings are appended to Output rather than printed, so a whole crowd is
+// written with one stream call and one flush at the end.
 class CSpeaker 
 {
     public:
-        virtual void GreetUser() = 0;
+        virtual ~CSpeaker() {}
+        virtual void GreetUser(std::string& Output) = 0;
         void GreetCount();
         void PrintCount();
+        int GetId() const;
+
+        // New speaker for Id, or NULL if there is no such speaker
+        static CSpeaker* Create(int Id);
 
     private:
         int count = 0;
 
     protected:
-        std::string name;
+        const char* name;
+        int id;
 
 };
 
@@ -30,10 +67,11 @@ class CEnglishSpeaker: public CSpeaker
     public:
         CEnglishSpeaker() 
         {
-            name = "English Speaker";
+            name = SpeakerNames[SPEAKER_ENGLISH];
+            id = SPEAKER_ENGLISH;
         }
 
-        void GreetUser();
+        void GreetUser(std::string& Output);
     
     private:
 };
@@ -41,7 +79,13 @@ class CEnglishSpeaker: public CSpeaker
 class CAdvancedEnglishSpeaker: public CEnglishSpeaker
 {
     public:
-        void GreetUser();
+        CAdvancedEnglishSpeaker()
+        {
+            name = SpeakerNames[SPEAKER_ADVANCED_ENGLISH];
+            id = SPEAKER_ADVANCED_ENGLISH;
+        }
+
+        void GreetUser(std::string& Output);
 };
 
 class CItalianSpeaker: public CSpeaker
@@ -49,10 +93,11 @@ class CItalianSpeaker: public CSpeaker
     public:
         CItalianSpeaker() 
         {
-            name = "Italian Speaker";
+            name = SpeakerNames[SPEAKER_ITALIAN];
+            id = SPEAKER_ITALIAN;
         }
 
-        void GreetUser();
+        void GreetUser(std::string& Output);
 
     private:
 
@@ -63,93 +108,414 @@ class CFrenchSpeaker: public CSpeaker
     public:
         CFrenchSpeaker()
         {
-            name = "French Speaker";
+            name = SpeakerNames[SPEAKER_FRENCH];
+            id = SPEAKER_FRENCH;
         }
 
-        void GreetUser();
+        void GreetUser(std::string& Output);
 
     private:
 
 };
 
-//---Main----------------------------------------------------------------------
-int main(void) 
+// Greetings per language, counted without locks or shared cache lines. Each
+// thread owns one shard and is its only writer, so a count is a plain load
+// and store. Each shard fills whole cache lines so two threads never write
+// the same line. Readers add the shards up whenever they want a total.
+class CGreetingCounters
+{
+    public:
+        struct alignas(CacheLineSize) Shard
+        {
+            std::atomic<uint64_t> Counts[NUM_SPEAKER_IDS];
+
+            void Add(int Id);
+        };
+
+        struct Snapshot
+        {
+            uint64_t Counts[NUM_SPEAKER_IDS];
+            std::chrono::steady_clock::time_point Time;
+        };
+
+        CGreetingCounters(int NumberOfShards);
+
+        Shard& GetShard(int Thread);
+        Snapshot TakeSnapshot() const;
+
+        // Greetings per second of each language between two snapshots
+        static void ReportRates(const Snapshot& Before, const Snapshot& After);
+
+    private:
+        std::vector<Shard> Shards;
+};
+
+// Slots for one speaker class, carved out of blocks of SpeakerPoolBlockSize.
+// A released slot goes on a free list and is handed out again before any new
+// block is allocated, so once the pool has grown to the largest request it
+// never touches the heap again.
+template <class TSpeaker>
+class CSpeakerPool
+{
+    public:
+        CSpeakerPool();
+
+        // Every speaker must have been released
+        ~CSpeakerPool();
+
+        TSpeaker* Acquire();
+        void Release(TSpeaker* pSpeaker);
+
+        long GetBlocks() const;
+        long GetLive() const;
+        long GetAcquired() const;
+
+        // Heap allocations the pool has made, its blocks and its list of them
+        long GetAllocations() const;
+
+    private:
+        union Slot
+        {
+            Slot* pNext;
+            alignas(TSpeaker) unsigned char Storage[sizeof(TSpeaker)];
+        };
+
+        std::vector<Slot*> Blocks;
+        Slot* pFree;
+        long Live;
+        long Acquired;
+        long Allocations;
+};
+
+// One pool per speaker class, picked by language ID
+class CSpeakerArena
 {
+    public:
+        // Speaker for Id from its pool, or NULL if there is no such speaker
+        CSpeaker* Create(int Id);
+
+        // Gives a speaker from Create back to its pool
+        void Release(CSpeaker* pSpeaker);
 
-    const int NumberOfSpeakers = 6;
-    int count = 0;
-    std::string InitialArrayOfSpeakers;
-    int ArrayOfSpeakers[NumberOfSpeakers];
+        // Blocks, live speakers and total acquisitions of each pool
+        void ReportCounts();
 
-    std::cout << "Enter the speaker order (separated by a space): " << std::endl;
-    std::getline(std::cin, InitialArrayOfSpeakers);
+        // Heap allocations of all the pools together
+        long GetAllocations() const;
+
+    private:
+        CSpeakerPool<CEnglishSpeaker> English;
+        CSpeakerPool<CFrenchSpeaker> French;
+        CSpeakerPool<CItalianSpeaker> Italian;
+        CSpeakerPool<CAdvancedEnglishSpeaker> AdvancedEnglish;
+};
+
+// Every speaker by value, so a list of them is one contiguous array
+typedef std::variant<CEnglishSpeaker, CFrenchSpeaker, CItalianSpeaker, CAdvancedEnglishSpeaker> CAnySpeaker;
+
+// Speakers stored by value and greeted with std::visit. The call names the
+// exact class, so GreetUser is called directly instead of through the vtable.
+class CSpeakerList
+{
+    public:
+        // Adds the speaker for Id, false if there is no such speaker
+        bool Add(int Id);
+        void Reserve(size_t Size);
+        void GreetAll(std::string& Output);
 
-    std::istringstream iss(InitialArrayOfSpeakers);
+        // Greets speakers Begin to End-1 and counts each greeting in Counts
+        void GreetRange(size_t Begin, size_t End, std::string& Output, CGreetingCounters::Shard& Counts);
+        size_t GetSize() const;
 
-    for (int i = 0; i < (NumberOfSpeakers*2)-1; i++) 
+    private:
+        std::vector<CAnySpeaker> Speakers;
+};
+
+// Speaker IDs separated by spaces, tabs, commas or newlines, any number of
+// them. The text is scanned in place with std::from_chars, nothing is copied
+// out per ID, and anything that is not a known ID stops the parse.
+class CSpeakerOrder
+{
+    public:
+        CSpeakerOrder();
+
+        // IDs from 0 to Count-1 are accepted, NUM_SPEAKER_IDS unless set
+        void SetNumberOfIds(int Count);
+
+        bool Parse(const char* Begin, const char* End);
+
+        // Reads the whole file, or all of stdin for "-", then parses it
+        bool Load(const char* FileName);
+
+        const std::vector<int>& GetIds() const;
+        const std::string& GetError() const;
+
+    private:
+        static bool IsSeparator(char Character);
+
+        std::vector<int> Ids;
+        std::string Error;
+        int NumberOfIds;
+};
+
+// Every distinct string once, end to end in one buffer, each with its
+// offset and length. Interning a string that is already there returns the
+// existing index, so a catalog where many languages share a greeting only
+// stores it once.
+class CStringTable
+{
+    public:
+        CStringTable() = default;
+
+        // Indices views the characters, so a copy would point into the original
+        CStringTable(const CStringTable&) = delete;
+        CStringTable& operator=(const CStringTable&) = delete;
+
+        void Clear();
+
+        // Room for Bytes characters, so the buffer never moves while loading
+        void Reserve(size_t Bytes);
+
+        int Intern(std::string_view Text);
+        std::string_view Get(int Index) const;
+
+        int GetSize() const;
+        size_t GetBytes() const;
+
+    private:
+        std::string Characters;
+        std::vector<uint32_t> Offsets;
+        std::vector<uint32_t> Lengths;
+        std::unordered_map<std::string_view, int> Indices;                  // Views into Characters
+};
+
+// Languages loaded from text with one "name<TAB>greeting" line each, the
+// line order giving the language ID. Blank lines and lines starting with #
+// are skipped. A greeting is two array lookups, no virtual call and no class
+// per language.
+class CGreetingCatalog
+{
+    public:
+        bool Parse(const char* Begin, const char* End);
+        bool Load(const char* FileName);
+
+        void Greet(int Id, std::string& Output) const;
+        std::string_view GetName(int Id) const;
+
+        int GetNumberOfLanguages() const;
+        const CStringTable& GetStrings() const;
+        const std::string& GetError() const;
+
+    private:
+        CStringTable Strings;
+        std::vector<int> Names;                                             // String index of each language's name
+        std::vector<int> Greetings;                                         // And of its greeting
+        std::string Error;
+};
+
+// Whole file, or all of stdin for "-"
+bool ReadWholeFile(const char* FileName, std::string& Text);
+
+// Appends everything left in Input, for streams whose size is not known
+bool ReadAllBlocks(std::istream& Input, std::string& Text);
+
+// Random crowd of speakers, the same for the same seed
+void RandomSpeakerIds(long NumberOfSpeakers, uint32_t Seed, std::vector<int>& Ids);
+
+// Threads greet their own slices of one crowd, round after round, while the
+// main thread prints greetings per second of each language
+void RunGreetingMetrics(long NumberOfSpeakers, int Threads, int Rounds);
+
+// A greeting service: every request creates a crowd from the arena, greets
+// it into a reused output block and releases it, and the allocations of
+// each request are counted
+void RunGreetingService(long Requests, long NumberOfSpeakers);
+
+// Every operator new in the program while CountHeapAllocations is set, so the
+// service can check that nothing on the request path allocates. Only the
+// service sets it, the other modes pay for one test of the flag.
+extern std::atomic<long> HeapAllocations;
+extern std::atomic<bool> CountHeapAllocations;
+
+// Loads a generated catalog of Languages languages and reports the time
+void BenchmarkCatalogLoad(long Languages);
+
+// Greets the same random crowd through new'd CSpeaker pointers and through a CSpeakerList
+void BenchmarkGreetings(long NumberOfSpeakers);
+
+//---Main----------------------------------------------------------------------
+int main(int argc, char* argv[]) 
+{
+    // "bench [speakers]" times virtual calls against the variant list
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
     {
-        if (i%2 == 0) 
+        long NumberOfSpeakers = argc > 2 ? atol(argv[2]) : DefaultBenchmarkSpeakers;
+        if (NumberOfSpeakers < 1)
         {
-            ArrayOfSpeakers[count] = (InitialArrayOfSpeakers[i] - '0');
-            count++;
+            std::cout << "Need at least 1 speaker" << std::endl;
+            return 1;
         }
+        BenchmarkGreetings(NumberOfSpeakers);
+        return 0;
     }
 
-    CEnglishSpeaker English;
-    CFrenchSpeaker French;
-    CItalianSpeaker Italian;
-    CAdvancedEnglishSpeaker ProficientEnglish;
+    // "metrics [speakers] [threads] [rounds]" greets from several threads and
+    // reports greetings per second of each language
+    if (argc > 1 && strcmp(argv[1], "metrics") == 0)
+    {
+        long NumberOfSpeakers = argc > 2 ? atol(argv[2]) : DefaultMetricsSpeakers;
+        int Threads = argc > 3 ? atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+        int Rounds = argc > 4 ? atoi(argv[4]) : DefaultMetricsRounds;
+        if (NumberOfSpeakers < 1 || Threads < 1 || Rounds < 1)
+        {
+            std::cout << "Need at least 1 speaker, 1 thread and 1 round" << std::endl;
+            return 1;
+        }
+        RunGreetingMetrics(NumberOfSpeakers, Threads, Rounds);
+        return 0;
+    }
 
-    CSpeaker** Speakers = new CSpeaker*[NumberOfSpeakers];
+    // "serve [requests] [speakers]" runs the greeting service on pooled speakers
+    if (argc > 1 && strcmp(argv[1], "serve") == 0)
+    {
+        long Requests = argc > 2 ? atol(argv[2]) : DefaultServeRequests;
+        long NumberOfSpeakers = argc > 3 ? atol(argv[3]) : DefaultServeSpeakers;
+        if (Requests < 1 || NumberOfSpeakers < 1)
+        {
+            std::cout << "Need at least 1 request and 1 speaker" << std::endl;
+            return 1;
+        }
+        RunGreetingService(Requests, NumberOfSpeakers);
+        return 0;
+    }
+
+    // "catalog <file> [order file]" greets with the languages in the catalog
+    // file, "catalog-bench [languages]" times loading a synthetic catalog
+    if (argc > 1 && strcmp(argv[1], "catalog-bench") == 0)
+    {
+        long Languages = argc > 2 ? atol(argv[2]) : DefaultCatalogBenchLanguages;
+        if (Languages < 1)
+        {
+            std::cout << "Need at least 1 language" << std::endl;
+            return 1;
+        }
+        BenchmarkCatalogLoad(Languages);
+        return 0;
+    }
 
-    for (int i = 0; i < NumberOfSpeakers; i++) 
+    if (argc > 2 && strcmp(argv[1], "catalog") == 0)
     {
-        if (ArrayOfSpeakers[i] == 0) 
+        CGreetingCatalog Catalog;
+        std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+        if (!Catalog.Load(argv[2]))
         {
-            Speakers[i] = new CEnglishSpeaker;
+            std::cout << Catalog.GetError() << std::endl;
+            return 1;
         }
+        std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+        std::cerr << "Loaded " << Catalog.GetNumberOfLanguages() << " languages, " << Catalog.GetStrings().GetSize()
+                  << " distinct strings in " << Elapsed.count() << " s" << std::endl;
 
-        if (ArrayOfSpeakers[i] == 1)
+        CSpeakerOrder Order;
+        Order.SetNumberOfIds(Catalog.GetNumberOfLanguages());
+        bool Parsed;
+        if (argc > 3)
+        {
+            Parsed = Order.Load(argv[3]);
+        }
+        else
+        {
+            std::string Line;
+            std::cout << "Enter the speaker order (separated by a space): " << std::endl;
+            std::getline(std::cin, Line);
+            Parsed = Order.Parse(Line.data(), Line.data() + Line.size());
+        }
+        if (!Parsed)
         {
-            Speakers[i] = new CFrenchSpeaker;
+            std::cout << Order.GetError() << std::endl;
+            return 1;
         }
 
-        if (ArrayOfSpeakers[i] == 2) 
+        std::string Output;
+        for (size_t i = 0; i < Order.GetIds().size(); i++)
         {
-            Speakers[i] = new CItalianSpeaker;
+            Catalog.Greet(Order.GetIds()[i], Output);
         }
+        std::cout << Output << std::flush;
+        return 0;
     }
 
-    for (int i = 0; i < NumberOfSpeakers; i++) 
+    // "file <name>" reads the order from a file, "file -" from all of stdin
+    CSpeakerOrder Order;
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    if (argc > 2 && strcmp(argv[1], "file") == 0)
     {
-        Speakers[i]->GreetUser();
+        if (!Order.Load(argv[2]))
+        {
+            std::cout << Order.GetError() << std::endl;
+            return 1;
+        }
     }
+    else
+    {
+        std::string InitialArrayOfSpeakers;
 
-    delete [] Speakers;
+        std::cout << "Enter the speaker order (separated by a space): " << std::endl;
+        std::getline(std::cin, InitialArrayOfSpeakers);
+
+        if (!Order.Parse(InitialArrayOfSpeakers.data(), InitialArrayOfSpeakers.data() + InitialArrayOfSpeakers.size()))
+        {
+            std::cout << Order.GetError() << std::endl;
+            return 1;
+        }
+    }
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+
+    const std::vector<int>& ArrayOfSpeakers = Order.GetIds();
+    if (argc > 2)
+    {
+        std::cerr << "Read " << ArrayOfSpeakers.size() << " speaker IDs in " << Elapsed.count() << " s" << std::endl;
+    }
+
+    CSpeakerList Speakers;
+    Speakers.Reserve(ArrayOfSpeakers.size());
+
+    for (size_t i = 0; i < ArrayOfSpeakers.size(); i++) 
+    {
+        Speakers.Add(ArrayOfSpeakers[i]);
+    }
+
+    std::string Output;
+    Speakers.GreetAll(Output);
+    std::cout << Output << std::flush;
 }
 
 //---Implementation------------------------------------------------------------
-void CEnglishSpeaker::GreetUser()
+void CEnglishSpeaker::GreetUser(std::string& Output)
 {
-    std::cout << "Hello World." << std::endl;
+    Output += SpeakerGreetings[SPEAKER_ENGLISH];
+    Output += '\n';
     GreetCount();
 }
 
-void CItalianSpeaker::GreetUser()
+void CItalianSpeaker::GreetUser(std::string& Output)
 {
-    std::cout << "Ciao World." << std::endl;
+    Output += SpeakerGreetings[SPEAKER_ITALIAN];
+    Output += '\n';
     GreetCount();
 }
 
-void CFrenchSpeaker::GreetUser()
+void CFrenchSpeaker::GreetUser(std::string& Output)
 {
-    std::cout << "Bonjour World." << std::endl;
+    Output += SpeakerGreetings[SPEAKER_FRENCH];
+    Output += '\n';
     GreetCount();
 }
 
-void CAdvancedEnglishSpeaker::GreetUser()
+void CAdvancedEnglishSpeaker::GreetUser(std::string& Output)
 {
-    std::cout << "My name is Ari" << std::endl;
+    Output += SpeakerGreetings[SPEAKER_ADVANCED_ENGLISH];
+    Output += '\n';
     GreetCount();
 }
 
@@ -158,7 +524,760 @@ void CSpeaker::GreetCount()
     count++;
 }
 
+int CSpeaker::GetId() const
+{
+    return id;
+}
+
 void CSpeaker::PrintCount() 
 {
     std::cout << "The number of greetings are: " << count << " for " << name << std::endl;
-}
\ No newline at end of file
+}
+
+CSpeaker* CSpeaker::Create(int Id)
+{
+    switch (Id)
+    {
+        case SPEAKER_ENGLISH:           return new CEnglishSpeaker;
+        case SPEAKER_FRENCH:            return new CFrenchSpeaker;
+        case SPEAKER_ITALIAN:           return new CItalianSpeaker;
+        case SPEAKER_ADVANCED_ENGLISH:  return new CAdvancedEnglishSpeaker;
+    }
+    return NULL;
+}
+
+bool CSpeakerList::Add(int Id)
+{
+    switch (Id)
+    {
+        case SPEAKER_ENGLISH:           Speakers.emplace_back(CEnglishSpeaker()); return true;
+        case SPEAKER_FRENCH:            Speakers.emplace_back(CFrenchSpeaker()); return true;
+        case SPEAKER_ITALIAN:           Speakers.emplace_back(CItalianSpeaker()); return true;
+        case SPEAKER_ADVANCED_ENGLISH:  Speakers.emplace_back(CAdvancedEnglishSpeaker()); return true;
+    }
+    return false;
+}
+
+void CSpeakerList::Reserve(size_t Size)
+{
+    Speakers.reserve(Size);
+}
+
+void CSpeakerList::GreetAll(std::string& Output)
+{
+    for (size_t i = 0; i < Speakers.size(); i++)
+    {
+        std::visit([&Output](auto& Speaker)
+        {
+            typedef typename std::decay<decltype(Speaker)>::type Exact;
+            Speaker.Exact::GreetUser(Output);
+        }, Speakers[i]);
+    }
+}
+
+void CSpeakerList::GreetRange(size_t Begin, size_t End, std::string& Output, CGreetingCounters::Shard& Counts)
+{
+    for (size_t i = Begin; i < End; i++)
+    {
+        std::visit([&Output, &Counts](auto& Speaker)
+        {
+            typedef typename std::decay<decltype(Speaker)>::type Exact;
+            Speaker.Exact::GreetUser(Output);
+            Counts.Add(Speaker.GetId());
+        }, Speakers[i]);
+    }
+}
+
+size_t CSpeakerList::GetSize() const
+{
+    return Speakers.size();
+}
+
+CSpeakerOrder::CSpeakerOrder()
+{
+    NumberOfIds = NUM_SPEAKER_IDS;
+}
+
+void CSpeakerOrder::SetNumberOfIds(int Count)
+{
+    NumberOfIds = Count;
+}
+
+bool CSpeakerOrder::Parse(const char* Begin, const char* End)
+{
+    Ids.clear();
+    Ids.reserve((End - Begin) / 2 + 1);
+    Error.clear();
+
+    const char* Position = Begin;
+    while (true)
+    {
+        while (Position < End && IsSeparator(*Position))
+        {
+            Position++;
+        }
+        if (Position == End)
+        {
+            return true;
+        }
+
+        // The ID has to end at a separator, so "12a" is rejected rather than read as 12
+        int Id = -1;
+        std::from_chars_result Result = std::from_chars(Position, End, Id);
+        if (Result.ec != std::errc() || (Result.ptr < End && !IsSeparator(*Result.ptr)) || Id < 0 || Id >= NumberOfIds)
+        {
+            const char* TokenEnd = Position;
+            while (TokenEnd < End && !IsSeparator(*TokenEnd) && TokenEnd - Position < 20)
+            {
+                TokenEnd++;
+            }
+            Error = "Invalid speaker ID \"" + std::string(Position, TokenEnd) + "\" at position " + std::to_string(Ids.size() + 1)
+                  + ", IDs are 0 to " + std::to_string(NumberOfIds - 1);
+            return false;
+        }
+
+        Ids.push_back(Id);
+        Position = Result.ptr;
+    }
+}
+
+bool CSpeakerOrder::Load(const char* FileName)
+{
+    std::string Text;
+    if (!ReadWholeFile(FileName, Text))
+    {
+        Error = std::string("Cannot open ") + FileName;
+        return false;
+    }
+    return Parse(Text.data(), Text.data() + Text.size());
+}
+
+const std::vector<int>& CSpeakerOrder::GetIds() const
+{
+    return Ids;
+}
+
+const std::string& CSpeakerOrder::GetError() const
+{
+    return Error;
+}
+
+bool CSpeakerOrder::IsSeparator(char Character)
+{
+    return Character == ' ' || Character == '\t' || Character == '\n' || Character == '\r' || Character == ',';
+}
+
+// A pipe or /dev/stdin has no size to seek to, so it is read in blocks
+bool ReadWholeFile(const char* FileName, std::string& Text)
+{
+    Text.clear();
+    if (strcmp(FileName, "-") == 0)
+    {
+        return ReadAllBlocks(std::cin, Text);
+    }
+
+    std::ifstream File(FileName, std::ios::binary);
+    if (!File)
+    {
+        return false;
+    }
+    std::streamoff Size = File.seekg(0, std::ios::end) ? (std::streamoff)File.tellg() : -1;
+    if (Size < 0)
+    {
+        File.clear();
+        return ReadAllBlocks(File, Text);
+    }
+
+    Text.resize((size_t)Size);
+    File.seekg(0, std::ios::beg);
+    return File.read(&Text[0], Size) && File.gcount() == Size;
+}
+
+bool ReadAllBlocks(std::istream& Input, std::string& Text)
+{
+    char Block[1 << 16];
+    while (Input.read(Block, sizeof(Block)) || Input.gcount() > 0)
+    {
+        Text.append(Block, (size_t)Input.gcount());
+    }
+    return !Input.bad();
+}
+
+void CStringTable::Clear()
+{
+    Indices.clear();
+    Characters.clear();
+    Offsets.clear();
+    Lengths.clear();
+}
+
+void CStringTable::Reserve(size_t Bytes)
+{
+    Characters.reserve(Bytes);
+}
+
+// The views in Indices point into Characters, so it must not outgrow its reserve
+int CStringTable::Intern(std::string_view Text)
+{
+    std::unordered_map<std::string_view, int>::iterator Found = Indices.find(Text);
+    if (Found != Indices.end())
+    {
+        return Found->second;
+    }
+
+    if (Characters.size() + Text.size() > Characters.capacity())
+    {
+        Reserve(2 * (Characters.size() + Text.size()));
+
+        // The buffer moved, so the keys are rebuilt over the new copy
+        Indices.clear();
+        for (size_t i = 0; i < Offsets.size(); i++)
+        {
+            Indices[std::string_view(Characters.data() + Offsets[i], Lengths[i])] = (int)i;
+        }
+    }
+
+    int Index = (int)Offsets.size();
+    Offsets.push_back((uint32_t)Characters.size());
+    Lengths.push_back((uint32_t)Text.size());
+    Characters.append(Text.data(), Text.size());
+    Indices[std::string_view(Characters.data() + Offsets[Index], Text.size())] = Index;
+    return Index;
+}
+
+std::string_view CStringTable::Get(int Index) const
+{
+    return std::string_view(Characters.data() + Offsets[Index], Lengths[Index]);
+}
+
+int CStringTable::GetSize() const
+{
+    return (int)Offsets.size();
+}
+
+size_t CStringTable::GetBytes() const
+{
+    return Characters.size();
+}
+
+bool CGreetingCatalog::Parse(const char* Begin, const char* End)
+{
+    Strings.Clear();
+    Strings.Reserve(End - Begin);
+    Names.clear();
+    Greetings.clear();
+    Error.clear();
+
+    int LineNumber = 0;
+    for (const char* Line = Begin; Line < End; )
+    {
+        const char* LineEnd = (const char*)memchr(Line, '\n', End - Line);
+        LineEnd = LineEnd != NULL ? LineEnd : End;
+        const char* Next = LineEnd < End ? LineEnd + 1 : End;
+        LineNumber++;
+
+        if (LineEnd > Line && LineEnd[-1] == '\r')
+        {
+            LineEnd--;
+        }
+        if (LineEnd == Line || *Line == '#')
+        {
+            Line = Next;
+            continue;
+        }
+
+        const char* Tab = (const char*)memchr(Line, '\t', LineEnd - Line);
+        if (Tab == NULL || Tab == Line)
+        {
+            Error = "Line " + std::to_string(LineNumber) + " is not \"name<TAB>greeting\"";
+            return false;
+        }
+
+        Names.push_back(Strings.Intern(std::string_view(Line, Tab - Line)));
+        Greetings.push_back(Strings.Intern(std::string_view(Tab + 1, LineEnd - Tab - 1)));
+        Line = Next;
+    }
+
+    if (Names.empty())
+    {
+        Error = "The catalog has no languages";
+        return false;
+    }
+    return true;
+}
+
+bool CGreetingCatalog::Load(const char* FileName)
+{
+    std::string Text;
+    if (!ReadWholeFile(FileName, Text))
+    {
+        Error = std::string("Cannot open ") + FileName;
+        return false;
+    }
+    return Parse(Text.data(), Text.data() + Text.size());
+}
+
+void CGreetingCatalog::Greet(int Id, std::string& Output) const
+{
+    std::string_view Greeting = Strings.Get(Greetings[Id]);
+    Output.append(Greeting.data(), Greeting.size());
+    Output += '\n';
+}
+
+std::string_view CGreetingCatalog::GetName(int Id) const
+{
+    return Strings.Get(Names[Id]);
+}
+
+int CGreetingCatalog::GetNumberOfLanguages() const
+{
+    return (int)Names.size();
+}
+
+const CStringTable& CGreetingCatalog::GetStrings() const
+{
+    return Strings;
+}
+
+const std::string& CGreetingCatalog::GetError() const
+{
+    return Error;
+}
+
+void BenchmarkCatalogLoad(long Languages)
+{
+    std::string Text = "# Synthetic catalog\n";
+    for (int Id = 0; Id < NUM_SPEAKER_IDS; Id++)
+    {
+        Text += std::string(SpeakerNames[Id]) + "\t" + SpeakerGreetings[Id] + "\n";
+    }
+    for (long i = NUM_SPEAKER_IDS; i < Languages; i++)
+    {
+        Text += "Language " + std::to_string(i) + "\tGreeting number " + std::to_string(i % CatalogBenchGreetings) + ".\n";
+    }
+
+    CGreetingCatalog Catalog;
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    if (!Catalog.Parse(Text.data(), Text.data() + Text.size()))
+    {
+        std::cout << Catalog.GetError() << std::endl;
+        return;
+    }
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+
+    // Greeting every language once shows the lookup cost
+    std::string Output;
+    std::chrono::steady_clock::time_point GreetStart = std::chrono::steady_clock::now();
+    for (int Id = 0; Id < Catalog.GetNumberOfLanguages(); Id++)
+    {
+        Catalog.Greet(Id, Output);
+    }
+    std::chrono::duration<double> GreetElapsed = std::chrono::steady_clock::now() - GreetStart;
+
+    std::cout << Catalog.GetNumberOfLanguages() << " languages from " << Text.size() << " bytes loaded in " << Elapsed.count()
+              << " s (" << Text.size() / Elapsed.count() / 1e6 << " MB/s)\n";
+    std::cout << Catalog.GetStrings().GetSize() << " distinct strings in " << Catalog.GetStrings().GetBytes() << " bytes\n";
+    std::cout << "Greeted every language in " << GreetElapsed.count() << " s, language 0 is " << Catalog.GetName(0) << std::endl;
+}
+
+void BenchmarkGreetings(long NumberOfSpeakers)
+{
+    // Same order for both versions
+    std::vector<int> Ids;
+    RandomSpeakerIds(NumberOfSpeakers, 12345, Ids);
+
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    std::vector<CSpeaker*> Pointers(NumberOfSpeakers);
+    for (long i = 0; i < NumberOfSpeakers; i++)
+    {
+        Pointers[i] = CSpeaker::Create(Ids[i]);
+    }
+    std::chrono::steady_clock::time_point Built = std::chrono::steady_clock::now();
+
+    std::string VirtualOutput;
+    for (long i = 0; i < NumberOfSpeakers; i++)
+    {
+        Pointers[i]->GreetUser(VirtualOutput);
+    }
+    std::chrono::steady_clock::time_point Greeted = std::chrono::steady_clock::now();
+
+    for (long i = 0; i < NumberOfSpeakers; i++)
+    {
+        delete Pointers[i];
+    }
+
+    std::chrono::duration<double> VirtualBuild = Built - Start;
+    std::chrono::duration<double> VirtualGreet = Greeted - Built;
+
+    Start = std::chrono::steady_clock::now();
+    CSpeakerList List;
+    List.Reserve(NumberOfSpeakers);
+    for (long i = 0; i < NumberOfSpeakers; i++)
+    {
+        List.Add(Ids[i]);
+    }
+    Built = std::chrono::steady_clock::now();
+
+    std::string ListOutput;
+    List.GreetAll(ListOutput);
+    Greeted = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> ListBuild = Built - Start;
+    std::chrono::duration<double> ListGreet = Greeted - Built;
+
+    std::cout << NumberOfSpeakers << " speakers, " << ListOutput.size() << " bytes of greetings"
+              << (ListOutput == VirtualOutput ? "" : " (OUTPUTS DIFFER)") << "\n";
+    std::cout << "Virtual pointers: build " << VirtualBuild.count() << " s, greet " << VirtualGreet.count() << " s ("
+              << NumberOfSpeakers / VirtualGreet.count() / 1e6 << " million/s)\n";
+    std::cout << "Variant list:     build " << ListBuild.count() << " s, greet " << ListGreet.count() << " s ("
+              << NumberOfSpeakers / ListGreet.count() / 1e6 << " million/s)\n";
+    std::cout << "Greeting speedup: " << VirtualGreet.count() / ListGreet.count() << "x" << std::endl;
+}
+
+void RandomSpeakerIds(long NumberOfSpeakers, uint32_t Seed, std::vector<int>& Ids)
+{
+    Ids.resize(NumberOfSpeakers);
+    uint32_t State = Seed;
+    for (long i = 0; i < NumberOfSpeakers; i++)
+    {
+        State = State * 1664525 + 1013904223;
+        Ids[i] = (int)((State >> 16) % NUM_SPEAKER_IDS);
+    }
+}
+
+// Only the owning thread writes, so relaxed load and store are enough and no locked add is needed
+void CGreetingCounters::Shard::Add(int Id)
+{
+    Counts[Id].store(Counts[Id].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+CGreetingCounters::CGreetingCounters(int NumberOfShards)
+    : Shards(NumberOfShards)
+{
+    for (size_t s = 0; s < Shards.size(); s++)
+    {
+        for (int Id = 0; Id < NUM_SPEAKER_IDS; Id++)
+        {
+            Shards[s].Counts[Id].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+CGreetingCounters::Shard& CGreetingCounters::GetShard(int Thread)
+{
+    return Shards[Thread];
+}
+
+CGreetingCounters::Snapshot CGreetingCounters::TakeSnapshot() const
+{
+    Snapshot Result;
+    for (int Id = 0; Id < NUM_SPEAKER_IDS; Id++)
+    {
+        Result.Counts[Id] = 0;
+        for (size_t s = 0; s < Shards.size(); s++)
+        {
+            Result.Counts[Id] += Shards[s].Counts[Id].load(std::memory_order_relaxed);
+        }
+    }
+    Result.Time = std::chrono::steady_clock::now();
+    return Result;
+}
+
+void CGreetingCounters::ReportRates(const Snapshot& Before, const Snapshot& After)
+{
+    std::chrono::duration<double> Elapsed = After.Time - Before.Time;
+    for (int Id = 0; Id < NUM_SPEAKER_IDS; Id++)
+    {
+        std::cout << "  " << SpeakerNames[Id] << ": " << After.Counts[Id] << " total, "
+                  << (After.Counts[Id] - Before.Counts[Id]) / Elapsed.count() / 1e6 << " million/s\n";
+    }
+}
+
+void RunGreetingMetrics(long NumberOfSpeakers, int Threads, int Rounds)
+{
+    std::vector<int> Ids;
+    RandomSpeakerIds(NumberOfSpeakers, 12345, Ids);
+
+    CSpeakerList Speakers;
+    Speakers.Reserve(NumberOfSpeakers);
+    for (long i = 0; i < NumberOfSpeakers; i++)
+    {
+        Speakers.Add(Ids[i]);
+    }
+
+    // Each thread has its own slice of speakers, output block and shard, so
+    // nothing is shared until a thread finishes and wakes the main thread
+    CGreetingCounters Counters(Threads);
+    int Running = Threads;
+    std::mutex RunningLock;
+    std::condition_variable Finished;
+    std::vector<std::thread> Workers;
+    for (int t = 0; t < Threads; t++)
+    {
+        size_t Begin = (size_t)NumberOfSpeakers * t / Threads;
+        size_t End = (size_t)NumberOfSpeakers * (t + 1) / Threads;
+        Workers.push_back(std::thread([&Speakers, &Counters, &Running, &RunningLock, &Finished, Begin, End, t, Rounds]()
+        {
+            std::string Output;
+            for (int r = 0; r < Rounds; r++)
+            {
+                Output.clear();
+                Speakers.GreetRange(Begin, End, Output, Counters.GetShard(t));
+            }
+            std::lock_guard<std::mutex> Lock(RunningLock);
+            Running--;
+            Finished.notify_one();
+        }));
+    }
+
+    // The wait ends early when the last thread finishes, so the final snapshot
+    // is taken straight away and the overall rate has no idle time in it
+    CGreetingCounters::Snapshot First = Counters.TakeSnapshot();
+    CGreetingCounters::Snapshot Previous = First;
+    std::unique_lock<std::mutex> Lock(RunningLock);
+    while (Running > 0)
+    {
+        Finished.wait_for(Lock, std::chrono::milliseconds(MetricsIntervalMs), [&Running]() { return Running == 0; });
+        CGreetingCounters::Snapshot Current = Counters.TakeSnapshot();
+        std::chrono::duration<double> Since = Current.Time - First.Time;
+        std::cout << Since.count() << " s:\n";
+        CGreetingCounters::ReportRates(Previous, Current);
+        Previous = Current;
+    }
+    Lock.unlock();
+
+    for (int t = 0; t < Threads; t++)
+    {
+        Workers[t].join();
+    }
+
+    std::cout << "Overall with " << Threads << " threads:\n";
+    CGreetingCounters::ReportRates(First, Previous);
+    std::cout << std::flush;
+}
+
+template <class TSpeaker>
+CSpeakerPool<TSpeaker>::CSpeakerPool()
+{
+    pFree = NULL;
+    Live = 0;
+    Acquired = 0;
+    Allocations = 0;
+}
+
+template <class TSpeaker>
+CSpeakerPool<TSpeaker>::~CSpeakerPool()
+{
+    for (size_t b = 0; b < Blocks.size(); b++)
+    {
+        delete [] Blocks[b];
+    }
+}
+
+// An empty free list gets a whole new block threaded onto it
+template <class TSpeaker>
+TSpeaker* CSpeakerPool<TSpeaker>::Acquire()
+{
+    if (pFree == NULL)
+    {
+        Slot* pBlock = new Slot[SpeakerPoolBlockSize];
+        size_t Capacity = Blocks.capacity();
+        Blocks.push_back(pBlock);
+        Allocations += 1 + (Blocks.capacity() != Capacity);
+        for (int i = 0; i < SpeakerPoolBlockSize; i++)
+        {
+            pBlock[i].pNext = i + 1 < SpeakerPoolBlockSize ? &pBlock[i + 1] : NULL;
+        }
+        pFree = pBlock;
+    }
+
+    Slot* pSlot = pFree;
+    pFree = pSlot->pNext;
+    Live++;
+    Acquired++;
+    return new (pSlot->Storage) TSpeaker;
+}
+
+template <class TSpeaker>
+void CSpeakerPool<TSpeaker>::Release(TSpeaker* pSpeaker)
+{
+    pSpeaker->~TSpeaker();
+    Slot* pSlot = reinterpret_cast<Slot*>(pSpeaker);
+    pSlot->pNext = pFree;
+    pFree = pSlot;
+    Live--;
+}
+
+template <class TSpeaker>
+long CSpeakerPool<TSpeaker>::GetBlocks() const
+{
+    return (long)Blocks.size();
+}
+
+template <class TSpeaker>
+long CSpeakerPool<TSpeaker>::GetLive() const
+{
+    return Live;
+}
+
+template <class TSpeaker>
+long CSpeakerPool<TSpeaker>::GetAcquired() const
+{
+    return Acquired;
+}
+
+template <class TSpeaker>
+long CSpeakerPool<TSpeaker>::GetAllocations() const
+{
+    return Allocations;
+}
+
+CSpeaker* CSpeakerArena::Create(int Id)
+{
+    switch (Id)
+    {
+        case SPEAKER_ENGLISH:           return English.Acquire();
+        case SPEAKER_FRENCH:            return French.Acquire();
+        case SPEAKER_ITALIAN:           return Italian.Acquire();
+        case SPEAKER_ADVANCED_ENGLISH:  return AdvancedEnglish.Acquire();
+    }
+    return NULL;
+}
+
+// The ID says which pool, and so which exact class, the speaker came from
+void CSpeakerArena::Release(CSpeaker* pSpeaker)
+{
+    switch (pSpeaker->GetId())
+    {
+        case SPEAKER_ENGLISH:           English.Release(static_cast<CEnglishSpeaker*>(pSpeaker)); break;
+        case SPEAKER_FRENCH:            French.Release(static_cast<CFrenchSpeaker*>(pSpeaker)); break;
+        case SPEAKER_ITALIAN:           Italian.Release(static_cast<CItalianSpeaker*>(pSpeaker)); break;
+        case SPEAKER_ADVANCED_ENGLISH:  AdvancedEnglish.Release(static_cast<CAdvancedEnglishSpeaker*>(pSpeaker)); break;
+    }
+}
+
+void CSpeakerArena::ReportCounts()
+{
+    std::cout << "  " << SpeakerNames[SPEAKER_ENGLISH] << ": " << English.GetBlocks() << " blocks, " << English.GetLive()
+              << " live, " << English.GetAcquired() << " acquired\n";
+    std::cout << "  " << SpeakerNames[SPEAKER_FRENCH] << ": " << French.GetBlocks() << " blocks, " << French.GetLive()
+              << " live, " << French.GetAcquired() << " acquired\n";
+    std::cout << "  " << SpeakerNames[SPEAKER_ITALIAN] << ": " << Italian.GetBlocks() << " blocks, " << Italian.GetLive()
+              << " live, " << Italian.GetAcquired() << " acquired\n";
+    std::cout << "  " << SpeakerNames[SPEAKER_ADVANCED_ENGLISH] << ": " << AdvancedEnglish.GetBlocks() << " blocks, "
+              << AdvancedEnglish.GetLive() << " live, " << AdvancedEnglish.GetAcquired() << " acquired\n";
+}
+
+long CSpeakerArena::GetAllocations() const
+{
+    return English.GetAllocations() + French.GetAllocations() + Italian.GetAllocations() + AdvancedEnglish.GetAllocations();
+}
+
+std::atomic<long> HeapAllocations(0);
+std::atomic<bool> CountHeapAllocations(false);
+
+void* operator new(size_t Size)
+{
+    if (CountHeapAllocations.load(std::memory_order_relaxed))
+    {
+        HeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* pMemory = malloc(Size > 0 ? Size : 1);
+    if (pMemory == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return pMemory;
+}
+
+// Where a delete is inlined next to a library call of operator new, GCC
+// takes a direct free() for a mismatched pair. Freeing through a pointer it
+// cannot see into keeps it from warning.
+void (*volatile ReleaseMemory)(void*) = free;
+
+void operator delete(void* pMemory) noexcept
+{
+    ReleaseMemory(pMemory);
+}
+
+void operator delete(void* pMemory, size_t /*Size*/) noexcept
+{
+    ReleaseMemory(pMemory);
+}
+
+// Every request is a new random crowd of the same size, so the ID list and
+// the output block are big enough after the first request, and the pools
+// stop growing once they hold the most speakers any language has needed.
+// Every heap allocation in the program is counted while the requests run,
+// next to the pools' own counts and the buffers that grew, which show where
+// any of them came from.
+void RunGreetingService(long Requests, long NumberOfSpeakers)
+{
+    CSpeakerArena Arena;
+    std::vector<int> Ids;
+    std::vector<CSpeaker*> Crowd;
+    std::string Output;
+    long SteadyHeapAllocations = 0;
+    long SteadyAllocations = 0;
+    long SteadyGrowths = 0;
+    size_t Bytes = 0;
+
+    Crowd.reserve(NumberOfSpeakers);
+    CountHeapAllocations.store(true);
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    for (long r = 0; r < Requests; r++)
+    {
+        long HeapBefore = HeapAllocations.load();
+        long Before = Arena.GetAllocations();
+        size_t IdsCapacity = Ids.capacity();
+        size_t CrowdCapacity = Crowd.capacity();
+        size_t OutputCapacity = Output.capacity();
+
+        RandomSpeakerIds(NumberOfSpeakers, (uint32_t)r, Ids);
+        Crowd.clear();
+        for (long i = 0; i < NumberOfSpeakers; i++)
+        {
+            Crowd.push_back(Arena.Create(Ids[i]));
+        }
+
+        Output.clear();
+        for (long i = 0; i < NumberOfSpeakers; i++)
+        {
+            Crowd[i]->GreetUser(Output);
+        }
+        Bytes += Output.size();
+
+        for (long i = 0; i < NumberOfSpeakers; i++)
+        {
+            Arena.Release(Crowd[i]);
+        }
+
+        long HeapAllocationsMade = HeapAllocations.load() - HeapBefore;
+        long Allocations = Arena.GetAllocations() - Before;
+        long Growths = (Ids.capacity() != IdsCapacity) + (Crowd.capacity() != CrowdCapacity) + (Output.capacity() != OutputCapacity);
+        if (r == 0)
+        {
+            // Printed once the counts are taken, as printing may allocate
+            CountHeapAllocations.store(false);
+            std::cout << "Request 1: " << HeapAllocationsMade << " heap allocations, " << Allocations << " of them by the pools, "
+                      << Growths << " of 3 buffers grew\n";
+            CountHeapAllocations.store(true);
+        }
+        else
+        {
+            SteadyHeapAllocations += HeapAllocationsMade;
+            SteadyAllocations += Allocations;
+            SteadyGrowths += Growths;
+        }
+    }
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+    CountHeapAllocations.store(false);
+
+    std::cout << "Requests 2 to " << Requests << ": " << SteadyHeapAllocations << " heap allocations, " << SteadyAllocations
+              << " of them by the pools, " << SteadyGrowths << " buffer growths\n";
+    std::cout << Requests << " requests of " << NumberOfSpeakers << " speakers, " << Bytes << " bytes of greetings in "
+              << Elapsed.count() << " s\n";
+    std::cout << "Pools:\n";
+    Arena.ReportCounts();
+    std::cout << std::flush;
+}
@@ -1,115 +1,528 @@
 //--Includes-------------------------------------------------------------------
 #include <iostream>
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iomanip>
+#include <string>
+#include <fstream>
 
 //--Consts, enums and lists----------------------------------------------------
+const long DefaultBatchGames = 100000000;
+const int DefaultBatchDoors = 3;
+const uint64_t DefaultBatchSeed = 12345;
+const double ConfidenceZ = 1.96;                                            // z score of a 95% confidence interval
+const int DefaultDoorsOpened = 1;
+const int MinShuffleTableSize = 16;                                         // Starting size of CSparseShuffle's table, doubled as needed
+const long GamesPerChunk = 1 << 20;                                         // Games per random stream, fixed so results do not depend on thread count
+const long DefaultStrategyGames = 1000000;                                  // Games per cell of the strategy table
+const int StrategyTableDoors[] = { 3, 4, 5, 10, 100 };
+const double DefaultSwitchProbability = 0.5;
+const long DefaultCheckpointGames = 10000000;
+const char* const DefaultStatsFile = "montyhall_stats.csv";                 // A .json name writes JSON lines instead
+const int MaxStreakLength = 64;                                             // Longer win streaks share the last histogram bucket
 
 //---Forward Declarations------------------------------------------------------
-class CDoor;
-static CDoor* pDoor;
+class CDoorSet;
 
 //---Interface-----------------------------------------------------------------
 
-class CDoor 
+// xoshiro256** generator for every random choice in the game, much faster
+// than rand() and each instance is independent, so nothing is shared.
+// Stream picks one of many independent sequences for the same seed.
+class CRandom
 {
     public:
-        CDoor();
-        bool CarStatus;
-        bool PickedStatus;
-        void EditWin();
+        CRandom(uint64_t Seed, uint64_t Stream = 0);
+        uint64_t Next();
+
+        // Uniform number from 0 to Bound-1, using a multiply and shift instead of %
+        int NextBelow(int Bound);
 
     private:
-        int WinStatus;
+        uint64_t State[4];
+};
+
+// The doors of one game, stored as three packed bitsets (car, picked, opened)
+// so a million doors take a few hundred kilobytes. The car and picked doors
+// are also kept as indices so the host can find them without scanning.
+class CDoorSet
+{
+    public:
+        CDoorSet();
+
+        // Closes every door and removes the car
+        void Reset(int Doors);
+
+        void PlaceCar(int Door);
+        void Pick(int Door);
+        void Open(int Door);
 
+        bool HasCar(int Door) const;
+
+        int GetNumberOfDoors() const;
+        int GetCarDoor() const;
+        int GetPickedDoor() const;
+
+    private:
+        static void SetBit(std::vector<uint64_t>& Bits, int Door);
+        static bool TestBit(const std::vector<uint64_t>& Bits, int Door);
+
+        std::vector<uint64_t> CarBits;
+        std::vector<uint64_t> PickedBits;
+        std::vector<uint64_t> OpenedBits;
+        int NumberOfDoors;
+        int CarDoor;                                                        // -1 until the car is placed
+        int PickedDoor;                                                     // -1 until the player picks
+};
+
+// Draws the numbers 0 .. Size-1 in random order without repeats, each in O(1).
+// It is a Fisher-Yates shuffle of a virtual array holding 0 .. Size-1 where
+// only the moved entries are stored, in a small hash table that is emptied in
+// time proportional to the draws, so a million doors cost nothing up front.
+class CSparseShuffle
+{
+    public:
+        CSparseShuffle();
+
+        // Starts a new shuffle of 0 .. Size-1
+        void Start(int Size);
+
+        // Next number not drawn yet
+        int Draw(CRandom& Random);
+
+        // Number at Index of the virtual array, the undrawn ones are at Drawn and up
+        int At(int Index) const;
+        int GetDrawn() const;
+
+    private:
+        size_t FindSlot(int Index) const;
+        void Store(int Index, int Value);
+        void Grow();
+
+        std::vector<int> Keys;                                              // Virtual array index of each slot, -1 if empty
+        std::vector<int> Values;
+        std::vector<int> UsedSlots;                                         // Filled slots, so Start only clears those
+        int Size;
+        int Drawn;
+};
+
+// Plays LaneCount games side by side, one per lane. Every step is a plain
+// loop over the lanes with no branches, so the compiler turns each loop into
+// a few SIMD instructions. Each lane has its own xoshiro128** generator, kept
+// as one array per state word so a step updates all lanes at once.
+class CLaneKernel
+{
+    public:
+        static const int LaneCount = 16;
+
+        // Seeds every lane from Seeder, so one chunk stream gives one set of lanes
+        CLaneKernel(CRandom& Seeder);
+
+        // Plays Games games where the host opens one door, adding to the win tallies
+        void Play(long Games, int NumberOfDoors, long& StayWins, long& SwitchWins);
+
+    private:
+        // Next number from 0 to Bound-1 in each lane
+        void NextBelow(const uint32_t* Bound, uint32_t* Result);
 
+        uint32_t State[4][LaneCount];
 };
 
 class CHost
 {
     public:
         int PlayerInvite();
-        void OpenGoat(int NumberOfDoors);
+
+        // Opens DoorsToOpen random doors that are neither the car nor the player's pick
+        void OpenGoats(CDoorSet& Doors, int DoorsToOpen, CRandom& Random);
         void ChooseDoor();
         int ChooseAgain();
 
+        // Batch version of opening one door: a random door that is neither the car nor the pick.
+        // It keeps no state, so the strategy hosts call it without building a CHost.
+        static int ChooseGoat(int NumberOfDoors, int CarDoor, int PickedDoor, CRandom& Random);
+
+        // Batch version of opening several doors: StartOpening once per game, then
+        // each OpenNextGoat opens another goat door, all in constant time
+        void StartOpening(int NumberOfDoors, int CarDoor, int PickedDoor);
+        int OpenNextGoat(CRandom& Random);
+
+        // A random closed door other than the pick, the car included if not picked
+        int ChooseClosedDoor(CRandom& Random) const;
+
     private:
+        // Turns an index among the goat doors into a door number, skipping the car and the pick
+        int GoatDoor(int Index) const;
+
         int DoorNumber;
         int SecondChoiceNumber;
+        int GameCarDoor;
+        int GamePickedDoor;
+        int NumberOfGoats;                                                  // Doors the host may open
+        CSparseShuffle Goats;
 };
 
 class CPlayer
 {
     public:
-        void PickDoor(int DoorNumber, CDoor* pDoor);
+        void PickDoor(int DoorNumber, CDoorSet& Doors);
+
+        // Switches to a random closed door other than the first pick
+        int SwitchDoor(int NumberOfDoors, int PickedDoor, int OpenedDoor, CRandom& Random);
+
+        // Same, once the host has opened any number of doors
+        int SwitchDoor(const CHost& Host, CRandom& Random);
+
+    private:
+
+};
+
+// Host behaviours and player strategies for CGame::RunStrategy. They are plain
+// classes passed as template arguments, not a virtual interface, so each
+// combination gets its own inner loop with the calls inlined.
+//
+// A host's OpenDoor returns the door it opens, or -1 if it offers no switch.
+// A strategy's Choose returns the player's final door.
+
+// Monty: always opens a goat door the player did not pick
+class CStandardHost
+{
+    public:
+        int OpenDoor(int NumberOfDoors, int CarDoor, int PickedDoor, CRandom& Random) const;
+        const char* GetName() const;
+};
+
+// Opens any door but the pick, so sometimes shows the car and spoils the game
+class CIgnorantHost
+{
+    public:
+        int OpenDoor(int NumberOfDoors, int CarDoor, int PickedDoor, CRandom& Random) const;
+        const char* GetName() const;
+};
+
+// Only offers a switch when the player already has the car
+class CAdversarialHost
+{
+    public:
+        int OpenDoor(int NumberOfDoors, int CarDoor, int PickedDoor, CRandom& Random) const;
+        const char* GetName() const;
+};
+
+class CStayStrategy
+{
+    public:
+        int Choose(int NumberOfDoors, int PickedDoor, int OpenedDoor, CRandom& Random) const;
+        const char* GetName() const;
+};
+
+// Switches to a random closed door whenever the host offers
+class CSwitchStrategy
+{
+    public:
+        int Choose(int NumberOfDoors, int PickedDoor, int OpenedDoor, CRandom& Random) const;
+        const char* GetName() const;
+};
+
+// Switches with the given probability
+class CRandomSwitchStrategy
+{
+    public:
+        CRandomSwitchStrategy(double Probability);
+        int Choose(int NumberOfDoors, int PickedDoor, int OpenedDoor, CRandom& Random) const;
+        const char* GetName() const;
 
     private:
+        uint64_t Threshold;                                                 // Probability scaled to 2^32
+        std::string Name;
+};
+
+// Welford running mean and variance. Whole blocks can be merged in at once
+// (Chan's formula), so a loop only has to count and the stats are updated
+// once per block instead of once per game.
+class CRunningStats
+{
+    public:
+        CRunningStats();
 
+        void Add(double Value);
+
+        // Adds a block of Count values with the given mean and sum of squared deviations
+        void Merge(long BlockCount, double BlockMean, double BlockM2);
+
+        // Adds Count values that are each 0 or 1, Ones of them 1
+        void AddIndicators(long BlockCount, long Ones);
+
+        long GetCount() const;
+        double GetMean() const;
+        double GetVariance() const;
+
+    private:
+        long Count;
+        double Mean;
+        double M2;                                                          // Sum of squared deviations from the mean
+};
+
+// Lengths of runs of consecutive wins, 1 to MaxStreakLength
+class CStreakHistogram
+{
+    public:
+        CStreakHistogram();
+
+        void Add(bool Win);
+
+        // Counts the streak still running, if any
+        void Finish();
+
+        long GetStreaks(int Length) const;
+        int GetLongest() const;
+
+    private:
+        std::vector<long> Streaks;                                          // Streaks[Length], index 0 unused
+        int Current;
+        int Longest;
 };
 
 class CGame
 {
     public:
         CGame();
-        ~CGame();
         int Run();
         void DoorCheck(int DoorNumber);
-        void SecondDoorCheck(int SecondChoiceNumber);
+        void SecondDoorCheck(int SecondChoiceNumber, const CHost& Host);
+
+        struct BatchResult
+        {
+            long Games;
+            long StayWins;
+            long SwitchWins;
+        };
+
+        // Plays NumberOfGames headless games, scoring both staying and switching on each.
+        // Games are dealt out in chunks with one random stream per chunk, so a seed
+        // gives the same result whatever the number of threads. The host opens
+        // DoorsOpened goat doors, from 1 up to Doors-2.
+        // Lanes plays one-door games with CLaneKernel instead of the host and player objects.
+        BatchResult RunBatch(long Games, int Doors, uint64_t Seed, int Threads, int DoorsOpened = 1, bool Lanes = false);
+
+        // Win rates with 95% confidence intervals
+        void ReportBatch(const BatchResult& Result, double Seconds);
+
+        struct StrategyResult
+        {
+            long Games;                                                     // Games that counted
+            long Wins;
+            long Spoiled;                                                   // Games where the host showed the car
+        };
+
+        // Plays Games headless games of one host and one strategy, in chunks like RunBatch
+        template <class THost, class TStrategy>
+        StrategyResult RunStrategy(long Games, int Doors, uint64_t Seed, int Threads, const THost& Host, const TStrategy& Strategy);
+
+        // Win rates of every host and strategy pair for each of StrategyTableDoors
+        void ReportStrategies(long Games, uint64_t Seed, int Threads);
+
+        // Plays Games one-door games in order, keeping running stats and switch win
+        // streaks, and appends a snapshot to FileName every Checkpoint games.
+        // Nothing is written per game. Returns false if the file cannot be opened.
+        bool RunStreaming(long Games, int Doors, uint64_t Seed, long Checkpoint, const char* FileName);
+
+        CDoorSet& GetDoors();
+        CRandom& GetRandom();
 
     private:
-        int NumberOfGames;
+        // Plays chunks until none are left, tallying into Result
+        void BatchWorker(std::atomic<long>* pNextChunk, long NumberOfChunks, uint64_t Seed, BatchResult* pResult);
+        void PlayGames(long Games, CRandom& Random, BatchResult& Result);
+
+        // One line of the snapshot file, CSV or JSON
+        void WriteSnapshot(std::ofstream& File, bool Json, const CRunningStats& Stay, const CRunningStats& Switch,
+                           const CStreakHistogram& Streaks);
+
+        template <class THost, class TStrategy>
+        void StrategyWorker(std::atomic<long>* pNextChunk, long NumberOfChunks, uint64_t Seed, const THost* pHost,
+                            const TStrategy* pStrategy, StrategyResult* pResult);
+
+        // One row of the strategy table, a win rate per door count
+        template <class THost, class TStrategy>
+        void ReportStrategyRow(long Games, uint64_t Seed, int Threads, const THost& Host, const TStrategy& Strategy);
+
+        long NumberOfGames;
         int NumberOfDoors;
+        int NumberOfDoorsOpened;
+        bool UseLanes;
         int WinStatus;
+        CDoorSet Doors;
+        CRandom Random;                                                     // Seeded once per game object, never reseeded
 
 
 };
 
 
 //---Main----------------------------------------------------------------------
-int main(void) 
+int main(int argc, char* argv[]) 
 {
     CGame Game;
+
+    // "stream [games] [doors] [seed] [checkpoint] [file]" plays one long run
+    // and writes running statistics every checkpoint games
+    if (argc > 1 && strcmp(argv[1], "stream") == 0)
+    {
+        long Games = argc > 2 ? atol(argv[2]) : DefaultBatchGames;
+        int Doors = argc > 3 ? atoi(argv[3]) : DefaultBatchDoors;
+        uint64_t Seed = argc > 4 ? strtoull(argv[4], NULL, 10) : DefaultBatchSeed;
+        long Checkpoint = argc > 5 ? atol(argv[5]) : DefaultCheckpointGames;
+        const char* FileName = argc > 6 ? argv[6] : DefaultStatsFile;
+
+        if (Games < 1 || Doors < 3 || Checkpoint < 1)
+        {
+            std::cout << "Need at least 1 game, 3 doors and a checkpoint of 1 game" << std::endl;
+            return 1;
+        }
+        return Game.RunStreaming(Games, Doors, Seed, Checkpoint, FileName) ? 0 : 1;
+    }
+
+    // "strategies [games] [seed] [threads]" plays every host against every
+    // strategy and prints the win rates as a table
+    if (argc > 1 && strcmp(argv[1], "strategies") == 0)
+    {
+        long Games = argc > 2 ? atol(argv[2]) : DefaultStrategyGames;
+        uint64_t Seed = argc > 3 ? strtoull(argv[3], NULL, 10) : DefaultBatchSeed;
+        int Threads = argc > 4 ? atoi(argv[4]) : (int)std::thread::hardware_concurrency();
+
+        if (Games < 1)
+        {
+            std::cout << "Need at least 1 game" << std::endl;
+            return 1;
+        }
+        Game.ReportStrategies(Games, Seed, Threads > 0 ? Threads : 1);
+        return 0;
+    }
+
+    // "batch [games] [doors] [seed] [threads] [opened]" runs the headless
+    // simulation, "scaling [games] [doors]" runs it again for every thread count
+    // and "lanes [games] [doors] [seed] [threads]" races the SIMD lane kernel
+    // against the object path
+    if (argc > 1 && (strcmp(argv[1], "batch") == 0 || strcmp(argv[1], "scaling") == 0 || strcmp(argv[1], "lanes") == 0))
+    {
+        long Games = argc > 2 ? atol(argv[2]) : DefaultBatchGames;
+        int Doors = argc > 3 ? atoi(argv[3]) : DefaultBatchDoors;
+        uint64_t Seed = argc > 4 ? strtoull(argv[4], NULL, 10) : DefaultBatchSeed;
+        int Cores = (int)std::thread::hardware_concurrency();
+        int Threads = argc > 5 ? atoi(argv[5]) : Cores;
+        int Opened = argc > 6 ? atoi(argv[6]) : DefaultDoorsOpened;
+
+        if (Games < 1 || Doors < 3 || Threads < 1)
+        {
+            std::cout << "Need at least 1 game, 3 doors and 1 thread" << std::endl;
+            return 1;
+        }
+
+        if (Opened < 1 || Opened > Doors - 2)
+        {
+            std::cout << "The host can open 1 to " << Doors - 2 << " doors" << std::endl;
+            return 1;
+        }
+
+        if (strcmp(argv[1], "lanes") == 0)
+        {
+            if (Opened != 1)
+            {
+                std::cout << "The lane kernel plays games where the host opens 1 door" << std::endl;
+                return 1;
+            }
+
+            double Seconds[2];
+            for (int Lanes = 0; Lanes < 2; Lanes++)
+            {
+                std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+                CGame::BatchResult Result = Game.RunBatch(Games, Doors, Seed, Threads, 1, Lanes == 1);
+                std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+                Seconds[Lanes] = Elapsed.count();
+
+                std::cout << (Lanes == 1 ? "Lane kernel: " : "Objects: ");
+                Game.ReportBatch(Result, Seconds[Lanes]);
+            }
+            std::cout << "Lane kernel speedup: " << Seconds[0] / Seconds[1] << "x" << std::endl;
+            return 0;
+        }
+
+        int FirstThreads = strcmp(argv[1], "scaling") == 0 ? 1 : Threads;
+        int LastThreads = strcmp(argv[1], "scaling") == 0 ? (Cores > 0 ? Cores : 1) : Threads;
+        for (int t = FirstThreads; t <= LastThreads; t++)
+        {
+            std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+            CGame::BatchResult Result = Game.RunBatch(Games, Doors, Seed, t, Opened);
+            std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+
+            std::cout << t << " threads: ";
+            Game.ReportBatch(Result, Elapsed.count());
+        }
+        return 0;
+    }
+
     CHost Host;
     CPlayer Player;
     
 
-    int NumberOfDoors = Game.Run();
+    if (Game.Run() < 3)
+    {
+        std::cout << "Need at least 3 doors" << std::endl;
+        return 1;
+    }
         
     // Ask Player to pick a door
     int DoorNumber = Host.PlayerInvite();
+    if (DoorNumber < 0 || DoorNumber >= Game.GetDoors().GetNumberOfDoors())
+    {
+        std::cout << "There is no door " << DoorNumber << std::endl;
+        return 1;
+    }
 
     // Update the opened status
-    Player.PickDoor(DoorNumber, pDoor);
+    Player.PickDoor(DoorNumber, Game.GetDoors());
 
     // Check if the door has a car or a goat
     Game.DoorCheck(DoorNumber);
 
     // If not a car get the host to show a goat
 
-    Host.OpenGoat(NumberOfDoors);
+    Host.OpenGoats(Game.GetDoors(), 1, Game.GetRandom());
     // Let player either choose again 
 
     int SecondChoice = Host.ChooseAgain();
 
     // Picks a car --> win
     // Picks a goat --> loose 
+    Game.SecondDoorCheck(SecondChoice, Host);
+
     // Onto next game if possible 
 
 }
 
 //---Implementation------------------------------------------------------------
 CGame::CGame()
+    : Random((uint64_t)time(NULL))
 {
+    NumberOfDoorsOpened = 1;
+    UseLanes = false;
     WinStatus = 0;
 }
 
-CGame::~CGame()
+CDoorSet& CGame::GetDoors()
 {
-    delete [] pDoor;
+    return Doors;
 }
 
-CDoor::CDoor()
+CRandom& CGame::GetRandom()
 {
-    PickedStatus = 0;
+    return Random;
 }
 
 int CGame::Run() 
@@ -120,31 +533,14 @@ int CGame::Run()
     std::cout << "Enter the number of doors: " << std::endl;
     std::cin >> NumberOfDoors;
 
-    for (int i = 0; i < NumberOfDoors; i++)
+    if (NumberOfDoors < 3)
     {
-        pDoor = new CDoor[NumberOfDoors];
+        return NumberOfDoors;
     }
 
-    // Generate a random number in range of number of doors to define the car
-    srand((unsigned) time(NULL));
-		
-	// Retrieve a random number between 0 and NumberOfDoors
-	int random = (rand() % (NumberOfDoors));
-
-    //Set the index and assign the selected door to have the car
-
-    for (int i=0; i<NumberOfDoors; i++)
-    {
-        if (i == random) 
-        {
-            pDoor[i].CarStatus = 1;
-        }
-
-        else 
-            pDoor[i].CarStatus = 0;
-        
-        std::cout << pDoor[i].CarStatus << std::endl;
-    } 
+    // Put the car behind a random door
+    Doors.Reset(NumberOfDoors);
+    Doors.PlaceCar(Random.NextBelow(NumberOfDoors));
     return NumberOfDoors;
 }
 
@@ -156,41 +552,28 @@ int CHost::PlayerInvite()
     return DoorNumber;
 }
 
-void CHost::OpenGoat(int NumberOfDoors)
+// Every draw lands on a goat door that is still closed, so there is no retrying
+void CHost::OpenGoats(CDoorSet& Doors, int DoorsToOpen, CRandom& Random)
 {
-    // Generate a random number in range of number of doors to define the car
-    srand((unsigned) time(NULL));
-		
-	// Retrieve a random number between 0 and NumberOfDoors
-	int random = (rand() % (NumberOfDoors));
-
-    if (pDoor[random].CarStatus == 1 || pDoor[random].PickedStatus == 1)
+    StartOpening(Doors.GetNumberOfDoors(), Doors.GetCarDoor(), Doors.GetPickedDoor());
+    for (int i = 0; i < DoorsToOpen; i++)
     {
-        std::cout << "Host opened a car with a goat or is already picked." << std::endl;
-        OpenGoat(NumberOfDoors);
-    }    
+        int Door = OpenNextGoat(Random);
+        Doors.Open(Door);
 
-    else 
-        std::cout << "Host opened a door with a goat." << std::endl;
-        pDoor[random].PickedStatus = 1;
+        std::cout << "Host opened door " << Door << " with a goat." << std::endl;
+    }
 }
 
-void CPlayer::PickDoor(int DoorNumber, CDoor* pDoor)
+void CPlayer::PickDoor(int DoorNumber, CDoorSet& Doors)
 {
     // Change the value of the door to picked
-    pDoor[DoorNumber].PickedStatus = 1;
-
-    std::cout << "The picked status of the doors are: " << std::endl;
-
-    for (int i=0; i<3; i++)
-    {   
-        std::cout << pDoor[i].PickedStatus << std::endl;
-    } 
+    Doors.Pick(DoorNumber);
 }
 
 void CGame::DoorCheck(int DoorNumber)
 {
-    if (pDoor[DoorNumber].CarStatus == 1) 
+    if (Doors.HasCar(DoorNumber)) 
     {
         WinStatus = 1;
     }
@@ -198,25 +581,27 @@ void CGame::DoorCheck(int DoorNumber)
 }
 
 
-void CGame::SecondDoorCheck(int SecondChoiceNumber)
+// Swapping moves the pick to one of the doors the host left closed, drawn
+// straight from the host's goat shuffle so there is no retrying
+void CGame::SecondDoorCheck(int SecondChoiceNumber, const CHost& Host)
 {
     if (SecondChoiceNumber == 1) 
     {
-
+        int SwitchedDoor = Host.ChooseClosedDoor(Random);
+        Doors.Pick(SwitchedDoor);
+        WinStatus = Doors.HasCar(SwitchedDoor);
+        std::cout << "You swapped to door " << SwitchedDoor << "." << std::endl;
     }
 
-    if (SecondChoiceNumber == 0 && WinStatus == 1)
+    if (WinStatus == 1)
     {
         std::cout << "You have won." << std::endl;
     } 
 
-    if (SecondChoiceNumber == 0 && WinStatus == 0)
+    if (WinStatus == 0)
     {
         std::cout << "You have lost." << std::endl;
     }
-
-
-
 }
 
 int CHost::ChooseAgain()
@@ -227,11 +612,865 @@ int CHost::ChooseAgain()
     return SecondChoiceNumber;
 }
 
+// splitmix64 spreads the seed over the whole state. Each stream starts the
+// splitmix counter four steps further on, so no two streams share a state.
+CRandom::CRandom(uint64_t Seed, uint64_t Stream)
+{
+    Seed += 4 * Stream * 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < 4; i++)
+    {
+        Seed += 0x9E3779B97F4A7C15ull;
+        uint64_t Mixed = Seed;
+        Mixed = (Mixed ^ (Mixed >> 30)) * 0xBF58476D1CE4E5B9ull;
+        Mixed = (Mixed ^ (Mixed >> 27)) * 0x94D049BB133111EBull;
+        State[i] = Mixed ^ (Mixed >> 31);
+    }
+}
+
+uint64_t CRandom::Next()
+{
+    uint64_t Product = State[1] * 5;
+    uint64_t Result = ((Product << 7) | (Product >> 57)) * 9;
+    uint64_t Shifted = State[1] << 17;
 
+    State[2] ^= State[0];
+    State[3] ^= State[1];
+    State[1] ^= State[2];
+    State[0] ^= State[3];
+    State[2] ^= Shifted;
+    State[3] = (State[3] << 45) | (State[3] >> 19);
+    return Result;
+}
 
+int CRandom::NextBelow(int Bound)
+{
+    return (int)(((Next() >> 32) * (uint64_t)Bound) >> 32);
+}
 
+// Picks among the doors left after removing the car and the pick by drawing
+// an index into that smaller range and stepping over the removed doors
+int CHost::ChooseGoat(int NumberOfDoors, int CarDoor, int PickedDoor, CRandom& Random)
+{
+    if (CarDoor == PickedDoor)
+    {
+        int Door = Random.NextBelow(NumberOfDoors - 1);
+        return Door + (Door >= PickedDoor);
+    }
 
+    int Low = CarDoor < PickedDoor ? CarDoor : PickedDoor;
+    int High = CarDoor < PickedDoor ? PickedDoor : CarDoor;
+    int Door = Random.NextBelow(NumberOfDoors - 2);
+    Door += (Door >= Low);
+    Door += (Door >= High);
+    return Door;
+}
 
+int CPlayer::SwitchDoor(int NumberOfDoors, int PickedDoor, int OpenedDoor, CRandom& Random)
+{
+    int Low = OpenedDoor < PickedDoor ? OpenedDoor : PickedDoor;
+    int High = OpenedDoor < PickedDoor ? PickedDoor : OpenedDoor;
+    int Door = Random.NextBelow(NumberOfDoors - 2);
+    Door += (Door >= Low);
+    Door += (Door >= High);
+    return Door;
+}
 
+void CHost::StartOpening(int NumberOfDoors, int CarDoor, int PickedDoor)
+{
+    GameCarDoor = CarDoor;
+    GamePickedDoor = PickedDoor;
+    NumberOfGoats = NumberOfDoors - (CarDoor == PickedDoor ? 1 : 2);
+    Goats.Start(NumberOfGoats);
+}
 
+int CHost::OpenNextGoat(CRandom& Random)
+{
+    return GoatDoor(Goats.Draw(Random));
+}
 
+// The closed doors are the undrawn goats plus the car when the player missed it
+int CHost::ChooseClosedDoor(CRandom& Random) const
+{
+    int ClosedGoats = NumberOfGoats - Goats.GetDrawn();
+    int Closed = ClosedGoats + (GameCarDoor != GamePickedDoor);
+    int Choice = Random.NextBelow(Closed);
+
+    if (Choice == ClosedGoats)
+    {
+        return GameCarDoor;
+    }
+    return GoatDoor(Goats.At(Goats.GetDrawn() + Choice));
+}
+
+int CHost::GoatDoor(int Index) const
+{
+    int Low = GameCarDoor < GamePickedDoor ? GameCarDoor : GamePickedDoor;
+    int High = GameCarDoor < GamePickedDoor ? GamePickedDoor : GameCarDoor;
+
+    Index += (Index >= Low);
+    if (High != Low)
+    {
+        Index += (Index >= High);
+    }
+    return Index;
+}
+
+int CPlayer::SwitchDoor(const CHost& Host, CRandom& Random)
+{
+    return Host.ChooseClosedDoor(Random);
+}
+
+CGame::BatchResult CGame::RunBatch(long Games, int Doors, uint64_t Seed, int Threads, int DoorsOpened, bool Lanes)
+{
+    NumberOfGames = Games;
+    NumberOfDoors = Doors;
+    NumberOfDoorsOpened = DoorsOpened;
+    UseLanes = Lanes && DoorsOpened == 1;
+
+    long NumberOfChunks = (Games + GamesPerChunk - 1) / GamesPerChunk;
+    std::atomic<long> NextChunk(0);
+
+    // Each thread tallies locally and only writes its slot once at the end
+    BatchResult Empty = { 0, 0, 0 };
+    std::vector<BatchResult> ThreadResults(Threads, Empty);
+    std::vector<std::thread> Workers;
+    for (int t = 0; t < Threads; t++)
+    {
+        Workers.push_back(std::thread(&CGame::BatchWorker, this, &NextChunk, NumberOfChunks, Seed, &ThreadResults[t]));
+    }
+
+    // Integer tallies add up the same in any order, so the totals are exact
+    BatchResult Result = Empty;
+    for (int t = 0; t < Threads; t++)
+    {
+        Workers[t].join();
+        Result.Games += ThreadResults[t].Games;
+        Result.StayWins += ThreadResults[t].StayWins;
+        Result.SwitchWins += ThreadResults[t].SwitchWins;
+    }
+    return Result;
+}
+
+void CGame::BatchWorker(std::atomic<long>* pNextChunk, long NumberOfChunks, uint64_t Seed, BatchResult* pResult)
+{
+    BatchResult Local = { 0, 0, 0 };
+    for (long Chunk = (*pNextChunk)++; Chunk < NumberOfChunks; Chunk = (*pNextChunk)++)
+    {
+        long Games = Chunk == NumberOfChunks - 1 ? NumberOfGames - Chunk * GamesPerChunk : GamesPerChunk;
+        CRandom Random(Seed, Chunk);
+        if (UseLanes)
+        {
+            CLaneKernel Kernel(Random);
+            Kernel.Play(Games, NumberOfDoors, Local.StayWins, Local.SwitchWins);
+            Local.Games += Games;
+        }
+        else
+        {
+            PlayGames(Games, Random, Local);
+        }
+    }
+    *pResult = Local;
+}
+
+void CGame::PlayGames(long Games, CRandom& Random, BatchResult& Result)
+{
+    CHost Host;
+    CPlayer Player;
+
+    for (long i = 0; i < Games; i++)
+    {
+        int CarDoor = Random.NextBelow(NumberOfDoors);
+        int PickedDoor = Random.NextBelow(NumberOfDoors);
+        int SwitchedDoor;
+
+        if (NumberOfDoorsOpened == 1)
+        {
+            int OpenedDoor = Host.ChooseGoat(NumberOfDoors, CarDoor, PickedDoor, Random);
+            SwitchedDoor = Player.SwitchDoor(NumberOfDoors, PickedDoor, OpenedDoor, Random);
+        }
+        else
+        {
+            Host.StartOpening(NumberOfDoors, CarDoor, PickedDoor);
+            for (int d = 0; d < NumberOfDoorsOpened; d++)
+            {
+                Host.OpenNextGoat(Random);
+            }
+            SwitchedDoor = Player.SwitchDoor(Host, Random);
+        }
+
+        Result.StayWins += (PickedDoor == CarDoor);
+        Result.SwitchWins += (SwitchedDoor == CarDoor);
+    }
+    Result.Games += Games;
+}
+
+void CGame::ReportBatch(const BatchResult& Result, double Seconds)
+{
+    double StayRate = (double)Result.StayWins / Result.Games;
+    double SwitchRate = (double)Result.SwitchWins / Result.Games;
+    double StayMargin = ConfidenceZ * sqrt(StayRate * (1 - StayRate) / Result.Games);
+    double SwitchMargin = ConfidenceZ * sqrt(SwitchRate * (1 - SwitchRate) / Result.Games);
+
+    std::cout << Result.Games << " games with " << NumberOfDoors << " doors in " << Seconds << " s ("
+              << Result.Games / Seconds / 1e6 << " million games/s)\n";
+    std::cout << "Stay wins:   " << Result.StayWins << " = " << StayRate << " +/- " << StayMargin << " (expected " << 1.0 / NumberOfDoors << ")\n";
+    std::cout << "Switch wins: " << Result.SwitchWins << " = " << SwitchRate << " +/- " << SwitchMargin << " (expected "
+              << (NumberOfDoors - 1.0) / (NumberOfDoors * (NumberOfDoors - 1.0 - NumberOfDoorsOpened)) << ")" << std::endl;
+}
+
+CDoorSet::CDoorSet()
+{
+    NumberOfDoors = 0;
+    CarDoor = -1;
+    PickedDoor = -1;
+}
+
+void CDoorSet::Reset(int Doors)
+{
+    NumberOfDoors = Doors;
+    CarDoor = -1;
+    PickedDoor = -1;
+
+    size_t Words = (Doors + 63) / 64;
+    CarBits.assign(Words, 0);
+    PickedBits.assign(Words, 0);
+    OpenedBits.assign(Words, 0);
+}
+
+void CDoorSet::PlaceCar(int Door)
+{
+    SetBit(CarBits, Door);
+    CarDoor = Door;
+}
+
+void CDoorSet::Pick(int Door)
+{
+    SetBit(PickedBits, Door);
+    PickedDoor = Door;
+}
+
+void CDoorSet::Open(int Door)
+{
+    SetBit(OpenedBits, Door);
+}
+
+bool CDoorSet::HasCar(int Door) const
+{
+    return TestBit(CarBits, Door);
+}
+
+int CDoorSet::GetNumberOfDoors() const
+{
+    return NumberOfDoors;
+}
+
+int CDoorSet::GetCarDoor() const
+{
+    return CarDoor;
+}
+
+int CDoorSet::GetPickedDoor() const
+{
+    return PickedDoor;
+}
+
+void CDoorSet::SetBit(std::vector<uint64_t>& Bits, int Door)
+{
+    Bits[Door / 64] |= 1ull << (Door % 64);
+}
+
+bool CDoorSet::TestBit(const std::vector<uint64_t>& Bits, int Door)
+{
+    return (Bits[Door / 64] >> (Door % 64)) & 1;
+}
+
+CSparseShuffle::CSparseShuffle()
+{
+    Keys.assign(MinShuffleTableSize, -1);
+    Values.assign(MinShuffleTableSize, 0);
+    Size = 0;
+    Drawn = 0;
+}
+
+void CSparseShuffle::Start(int NewSize)
+{
+    for (size_t i = 0; i < UsedSlots.size(); i++)
+    {
+        Keys[UsedSlots[i]] = -1;
+    }
+    UsedSlots.clear();
+    Size = NewSize;
+    Drawn = 0;
+}
+
+// Swaps a random undrawn entry into position Drawn and hands it out
+int CSparseShuffle::Draw(CRandom& Random)
+{
+    int Swap = Drawn + Random.NextBelow(Size - Drawn);
+    int Value = At(Swap);
+    Store(Swap, At(Drawn));
+    Drawn++;
+    return Value;
+}
+
+// Entries that were never moved still hold their own index
+int CSparseShuffle::At(int Index) const
+{
+    size_t Slot = FindSlot(Index);
+    return Keys[Slot] == Index ? Values[Slot] : Index;
+}
+
+int CSparseShuffle::GetDrawn() const
+{
+    return Drawn;
+}
+
+size_t CSparseShuffle::FindSlot(int Index) const
+{
+    size_t Mask = Keys.size() - 1;
+    size_t Slot = ((uint32_t)Index * 2654435761u) & Mask;
+    while (Keys[Slot] != -1 && Keys[Slot] != Index)
+    {
+        Slot = (Slot + 1) & Mask;
+    }
+    return Slot;
+}
+
+void CSparseShuffle::Store(int Index, int Value)
+{
+    size_t Slot = FindSlot(Index);
+    if (Keys[Slot] == -1)
+    {
+        Keys[Slot] = Index;
+        UsedSlots.push_back((int)Slot);
+    }
+    Values[Slot] = Value;
+
+    if (UsedSlots.size() * 2 > Keys.size())
+    {
+        Grow();
+    }
+}
+
+// Doubles the table and reinserts the stored entries
+void CSparseShuffle::Grow()
+{
+    std::vector<int> OldKeys;
+    std::vector<int> OldValues;
+    std::vector<int> OldSlots;
+    OldKeys.swap(Keys);
+    OldValues.swap(Values);
+    OldSlots.swap(UsedSlots);
+
+    Keys.assign(OldKeys.size() * 2, -1);
+    Values.assign(OldKeys.size() * 2, 0);
+    for (size_t i = 0; i < OldSlots.size(); i++)
+    {
+        size_t Slot = FindSlot(OldKeys[OldSlots[i]]);
+        Keys[Slot] = OldKeys[OldSlots[i]];
+        Values[Slot] = OldValues[OldSlots[i]];
+        UsedSlots.push_back((int)Slot);
+    }
+}
+
+CLaneKernel::CLaneKernel(CRandom& Seeder)
+{
+    for (int l = 0; l < LaneCount; l++)
+    {
+        uint64_t Low = Seeder.Next();
+        uint64_t High = Seeder.Next();
+        State[0][l] = (uint32_t)Low;
+        State[1][l] = (uint32_t)(Low >> 32);
+        State[2][l] = (uint32_t)High;
+        State[3][l] = (uint32_t)(High >> 32) | 1;                           // Never all zero
+    }
+}
+
+// xoshiro128** step and a multiply-shift range reduction in every lane
+void CLaneKernel::NextBelow(const uint32_t* Bound, uint32_t* Result)
+{
+    uint32_t* S0 = State[0];
+    uint32_t* S1 = State[1];
+    uint32_t* S2 = State[2];
+    uint32_t* S3 = State[3];
+
+    for (int l = 0; l < LaneCount; l++)
+    {
+        uint32_t Product = S1[l] * 5;
+        uint32_t Random = ((Product << 7) | (Product >> 25)) * 9;
+        uint32_t Shifted = S1[l] << 9;
+
+        S2[l] ^= S0[l];
+        S3[l] ^= S1[l];
+        S1[l] ^= S2[l];
+        S0[l] ^= S3[l];
+        S2[l] ^= Shifted;
+        S3[l] = (S3[l] << 11) | (S3[l] >> 21);
+
+        Result[l] = (uint32_t)(((uint64_t)Random * Bound[l]) >> 32);
+    }
+}
+
+// The same draws as ChooseGoat and SwitchDoor, with the ifs turned into
+// comparisons that add 0 or 1. The last block masks off the lanes past Games.
+void CLaneKernel::Play(long Games, int NumberOfDoors, long& StayWins, long& SwitchWins)
+{
+    uint32_t Doors[LaneCount];
+    uint32_t Car[LaneCount];
+    uint32_t Picked[LaneCount];
+    uint32_t Bound[LaneCount];
+    uint32_t Opened[LaneCount];
+    uint32_t Switched[LaneCount];
+    uint32_t StayCount[LaneCount];
+    uint32_t SwitchCount[LaneCount];
+
+    for (int l = 0; l < LaneCount; l++)
+    {
+        Doors[l] = (uint32_t)NumberOfDoors;
+        StayCount[l] = 0;
+        SwitchCount[l] = 0;
+    }
+
+    for (long Block = 0; Block < Games; Block += LaneCount)
+    {
+        long Left = Games - Block;
+
+        NextBelow(Doors, Car);
+        NextBelow(Doors, Picked);
+
+        // The host skips one door if the pick is the car, otherwise two
+        for (int l = 0; l < LaneCount; l++)
+        {
+            Bound[l] = Doors[l] - 2 + (Car[l] == Picked[l]);
+        }
+        NextBelow(Bound, Opened);
+        for (int l = 0; l < LaneCount; l++)
+        {
+            uint32_t Low = Car[l] < Picked[l] ? Car[l] : Picked[l];
+            uint32_t High = Car[l] < Picked[l] ? Picked[l] : Car[l];
+            Opened[l] += (Opened[l] >= Low);
+            Opened[l] += (Opened[l] >= High) & (Low != High);
+        }
+
+        // The player skips the pick and the opened door
+        for (int l = 0; l < LaneCount; l++)
+        {
+            Bound[l] = Doors[l] - 2;
+        }
+        NextBelow(Bound, Switched);
+        for (int l = 0; l < LaneCount; l++)
+        {
+            uint32_t Low = Opened[l] < Picked[l] ? Opened[l] : Picked[l];
+            uint32_t High = Opened[l] < Picked[l] ? Picked[l] : Opened[l];
+            Switched[l] += (Switched[l] >= Low);
+            Switched[l] += (Switched[l] >= High);
+
+            uint32_t Counted = (long)l < Left;
+            StayCount[l] += (Picked[l] == Car[l]) & Counted;
+            SwitchCount[l] += (Switched[l] == Car[l]) & Counted;
+        }
+    }
+
+    for (int l = 0; l < LaneCount; l++)
+    {
+        StayWins += StayCount[l];
+        SwitchWins += SwitchCount[l];
+    }
+}
+
+int CStandardHost::OpenDoor(int NumberOfDoors, int CarDoor, int PickedDoor, CRandom& Random) const
+{
+    return CHost::ChooseGoat(NumberOfDoors, CarDoor, PickedDoor, Random);
+}
+
+const char* CStandardHost::GetName() const
+{
+    return "Standard";
+}
+
+int CIgnorantHost::OpenDoor(int NumberOfDoors, int /*CarDoor*/, int PickedDoor, CRandom& Random) const
+{
+    int Door = Random.NextBelow(NumberOfDoors - 1);
+    return Door + (Door >= PickedDoor);
+}
+
+const char* CIgnorantHost::GetName() const
+{
+    return "Ignorant";
+}
+
+int CAdversarialHost::OpenDoor(int NumberOfDoors, int CarDoor, int PickedDoor, CRandom& Random) const
+{
+    if (CarDoor != PickedDoor)
+    {
+        return -1;
+    }
+    return CHost::ChooseGoat(NumberOfDoors, CarDoor, PickedDoor, Random);
+}
+
+const char* CAdversarialHost::GetName() const
+{
+    return "Adversarial";
+}
+
+int CStayStrategy::Choose(int /*NumberOfDoors*/, int PickedDoor, int /*OpenedDoor*/, CRandom& /*Random*/) const
+{
+    return PickedDoor;
+}
+
+const char* CStayStrategy::GetName() const
+{
+    return "Stay";
+}
+
+int CSwitchStrategy::Choose(int NumberOfDoors, int PickedDoor, int OpenedDoor, CRandom& Random) const
+{
+    if (OpenedDoor < 0)
+    {
+        return PickedDoor;
+    }
+    CPlayer Player;
+    return Player.SwitchDoor(NumberOfDoors, PickedDoor, OpenedDoor, Random);
+}
+
+const char* CSwitchStrategy::GetName() const
+{
+    return "Switch";
+}
+
+CRandomSwitchStrategy::CRandomSwitchStrategy(double Probability)
+{
+    Threshold = (uint64_t)(Probability * 4294967296.0);
+    Name = "Switch " + std::to_string((int)(Probability * 100 + 0.5)) + "%";
+}
+
+int CRandomSwitchStrategy::Choose(int NumberOfDoors, int PickedDoor, int OpenedDoor, CRandom& Random) const
+{
+    if (OpenedDoor < 0 || (Random.Next() >> 32) >= Threshold)
+    {
+        return PickedDoor;
+    }
+    CPlayer Player;
+    return Player.SwitchDoor(NumberOfDoors, PickedDoor, OpenedDoor, Random);
+}
+
+const char* CRandomSwitchStrategy::GetName() const
+{
+    return Name.c_str();
+}
+
+template <class THost, class TStrategy>
+CGame::StrategyResult CGame::RunStrategy(long Games, int Doors, uint64_t Seed, int Threads, const THost& Host, const TStrategy& Strategy)
+{
+    NumberOfGames = Games;
+    NumberOfDoors = Doors;
+    NumberOfDoorsOpened = 1;
+
+    long NumberOfChunks = (Games + GamesPerChunk - 1) / GamesPerChunk;
+    std::atomic<long> NextChunk(0);
+
+    StrategyResult Empty = { 0, 0, 0 };
+    std::vector<StrategyResult> ThreadResults(Threads, Empty);
+    std::vector<std::thread> Workers;
+    for (int t = 0; t < Threads; t++)
+    {
+        Workers.push_back(std::thread(&CGame::StrategyWorker<THost, TStrategy>, this, &NextChunk, NumberOfChunks, Seed,
+                                      &Host, &Strategy, &ThreadResults[t]));
+    }
+
+    StrategyResult Result = Empty;
+    for (int t = 0; t < Threads; t++)
+    {
+        Workers[t].join();
+        Result.Games += ThreadResults[t].Games;
+        Result.Wins += ThreadResults[t].Wins;
+        Result.Spoiled += ThreadResults[t].Spoiled;
+    }
+    return Result;
+}
+
+// Spoiled games are tallied but not scored, so the rates are for games where a goat was shown
+template <class THost, class TStrategy>
+void CGame::StrategyWorker(std::atomic<long>* pNextChunk, long NumberOfChunks, uint64_t Seed, const THost* pHost,
+                           const TStrategy* pStrategy, StrategyResult* pResult)
+{
+    StrategyResult Local = { 0, 0, 0 };
+    for (long Chunk = (*pNextChunk)++; Chunk < NumberOfChunks; Chunk = (*pNextChunk)++)
+    {
+        long Games = Chunk == NumberOfChunks - 1 ? NumberOfGames - Chunk * GamesPerChunk : GamesPerChunk;
+        CRandom Random(Seed, Chunk);
+
+        for (long i = 0; i < Games; i++)
+        {
+            int CarDoor = Random.NextBelow(NumberOfDoors);
+            int PickedDoor = Random.NextBelow(NumberOfDoors);
+            int OpenedDoor = pHost->OpenDoor(NumberOfDoors, CarDoor, PickedDoor, Random);
+
+            if (OpenedDoor == CarDoor)
+            {
+                Local.Spoiled++;
+                continue;
+            }
+
+            int FinalDoor = pStrategy->Choose(NumberOfDoors, PickedDoor, OpenedDoor, Random);
+            Local.Wins += (FinalDoor == CarDoor);
+            Local.Games++;
+        }
+    }
+    *pResult = Local;
+}
+
+template <class THost, class TStrategy>
+void CGame::ReportStrategyRow(long Games, uint64_t Seed, int Threads, const THost& Host, const TStrategy& Strategy)
+{
+    std::cout << std::left << std::setw(13) << Host.GetName() << std::setw(12) << Strategy.GetName() << std::right;
+    for (size_t d = 0; d < sizeof(StrategyTableDoors) / sizeof(StrategyTableDoors[0]); d++)
+    {
+        StrategyResult Result = RunStrategy(Games, StrategyTableDoors[d], Seed, Threads, Host, Strategy);
+        std::cout << std::setw(11) << (Result.Games > 0 ? (double)Result.Wins / Result.Games : 0.0);
+    }
+    std::cout << "\n";
+}
+
+void CGame::ReportStrategies(long Games, uint64_t Seed, int Threads)
+{
+    CStandardHost Standard;
+    CIgnorantHost Ignorant;
+    CAdversarialHost Adversarial;
+    CStayStrategy Stay;
+    CSwitchStrategy Switch;
+    CRandomSwitchStrategy RandomSwitch(DefaultSwitchProbability);
+
+    std::cout << "Win rate over " << Games << " games per cell\n";
+    std::cout << std::left << std::setw(13) << "Host" << std::setw(12) << "Strategy" << std::right;
+    for (size_t d = 0; d < sizeof(StrategyTableDoors) / sizeof(StrategyTableDoors[0]); d++)
+    {
+        std::cout << std::setw(5) << StrategyTableDoors[d] << " doors";
+    }
+    std::cout << "\n" << std::fixed << std::setprecision(4);
+
+    ReportStrategyRow(Games, Seed, Threads, Standard, Stay);
+    ReportStrategyRow(Games, Seed, Threads, Standard, Switch);
+    ReportStrategyRow(Games, Seed, Threads, Standard, RandomSwitch);
+    ReportStrategyRow(Games, Seed, Threads, Ignorant, Stay);
+    ReportStrategyRow(Games, Seed, Threads, Ignorant, Switch);
+    ReportStrategyRow(Games, Seed, Threads, Ignorant, RandomSwitch);
+    ReportStrategyRow(Games, Seed, Threads, Adversarial, Stay);
+    ReportStrategyRow(Games, Seed, Threads, Adversarial, Switch);
+    ReportStrategyRow(Games, Seed, Threads, Adversarial, RandomSwitch);
+    std::cout << std::defaultfloat << std::flush;
+}
+
+CRunningStats::CRunningStats()
+{
+    Count = 0;
+    Mean = 0;
+    M2 = 0;
+}
+
+void CRunningStats::Add(double Value)
+{
+    Count++;
+    double Delta = Value - Mean;
+    Mean += Delta / Count;
+    M2 += Delta * (Value - Mean);
+}
+
+void CRunningStats::Merge(long BlockCount, double BlockMean, double BlockM2)
+{
+    if (BlockCount == 0)
+    {
+        return;
+    }
+
+    long Total = Count + BlockCount;
+    double Delta = BlockMean - Mean;
+    Mean += Delta * BlockCount / Total;
+    M2 += BlockM2 + Delta * Delta * ((double)Count * BlockCount / Total);
+    Count = Total;
+}
+
+// A block of 0s and 1s has mean Ones/Count and squared deviations Ones*(Count-Ones)/Count
+void CRunningStats::AddIndicators(long BlockCount, long Ones)
+{
+    if (BlockCount == 0)
+    {
+        return;
+    }
+    Merge(BlockCount, (double)Ones / BlockCount, (double)Ones * (BlockCount - Ones) / BlockCount);
+}
+
+long CRunningStats::GetCount() const
+{
+    return Count;
+}
+
+double CRunningStats::GetMean() const
+{
+    return Mean;
+}
+
+double CRunningStats::GetVariance() const
+{
+    return Count > 1 ? M2 / (Count - 1) : 0;
+}
+
+CStreakHistogram::CStreakHistogram()
+{
+    Streaks.assign(MaxStreakLength + 1, 0);
+    Current = 0;
+    Longest = 0;
+}
+
+void CStreakHistogram::Add(bool Win)
+{
+    if (Win)
+    {
+        Current++;
+        return;
+    }
+    Finish();
+}
+
+void CStreakHistogram::Finish()
+{
+    if (Current == 0)
+    {
+        return;
+    }
+    Streaks[Current < MaxStreakLength ? Current : MaxStreakLength]++;
+    Longest = Current > Longest ? Current : Longest;
+    Current = 0;
+}
+
+long CStreakHistogram::GetStreaks(int Length) const
+{
+    return Streaks[Length];
+}
+
+int CStreakHistogram::GetLongest() const
+{
+    return Longest > Current ? Longest : Current;
+}
+
+// Same games as RunBatch with one door opened, chunk by chunk in order. Wins
+// are counted per chunk and checkpoint and merged into the stats in one go.
+bool CGame::RunStreaming(long Games, int Doors, uint64_t Seed, long Checkpoint, const char* FileName)
+{
+    std::ofstream File(FileName);
+    if (!File)
+    {
+        std::cout << "Cannot open " << FileName << std::endl;
+        return false;
+    }
+
+    size_t NameLength = strlen(FileName);
+    bool Json = NameLength >= 5 && strcmp(FileName + NameLength - 5, ".json") == 0;
+    if (!Json)
+    {
+        // One column per streak histogram bucket, as in the JSON "streaks" array
+        File << "games,stay_mean,stay_variance,switch_mean,switch_variance,switch_margin,longest_streak";
+        for (int Length = 1; Length <= MaxStreakLength; Length++)
+        {
+            File << ",streak_" << Length;
+        }
+        File << "\n";
+    }
+
+    NumberOfGames = Games;
+    NumberOfDoors = Doors;
+    NumberOfDoorsOpened = 1;
+
+    CHost Host;
+    CPlayer Player;
+    CRunningStats Stay;
+    CRunningStats Switch;
+    CStreakHistogram Streaks;
+
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    long NumberOfChunks = (Games + GamesPerChunk - 1) / GamesPerChunk;
+    long Played = 0;
+    for (long Chunk = 0; Chunk < NumberOfChunks; Chunk++)
+    {
+        long ChunkGames = Chunk == NumberOfChunks - 1 ? Games - Chunk * GamesPerChunk : GamesPerChunk;
+        CRandom Random(Seed, Chunk);
+
+        // Split the chunk wherever a checkpoint falls inside it
+        long Done = 0;
+        while (Done < ChunkGames)
+        {
+            long BlockGames = Checkpoint - Played % Checkpoint;
+            BlockGames = BlockGames < ChunkGames - Done ? BlockGames : ChunkGames - Done;
+
+            long StayWins = 0;
+            long SwitchWins = 0;
+            for (long i = 0; i < BlockGames; i++)
+            {
+                int CarDoor = Random.NextBelow(NumberOfDoors);
+                int PickedDoor = Random.NextBelow(NumberOfDoors);
+                int OpenedDoor = Host.ChooseGoat(NumberOfDoors, CarDoor, PickedDoor, Random);
+                int SwitchedDoor = Player.SwitchDoor(NumberOfDoors, PickedDoor, OpenedDoor, Random);
+
+                bool SwitchWin = SwitchedDoor == CarDoor;
+                StayWins += (PickedDoor == CarDoor);
+                SwitchWins += SwitchWin;
+                Streaks.Add(SwitchWin);
+            }
+
+            Stay.AddIndicators(BlockGames, StayWins);
+            Switch.AddIndicators(BlockGames, SwitchWins);
+            Done += BlockGames;
+            Played += BlockGames;
+
+            if (Played % Checkpoint == 0 || Played == Games)
+            {
+                WriteSnapshot(File, Json, Stay, Switch, Streaks);
+            }
+        }
+    }
+    Streaks.Finish();
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+
+    std::cout << Played << " games with " << NumberOfDoors << " doors in " << Elapsed.count() << " s, "
+              << (Games + Checkpoint - 1) / Checkpoint << " snapshots in " << FileName << "\n";
+    std::cout << "Stay:   mean " << Stay.GetMean() << " variance " << Stay.GetVariance() << "\n";
+    std::cout << "Switch: mean " << Switch.GetMean() << " variance " << Switch.GetVariance() << "\n";
+    std::cout << "Switch win streaks (length: count)\n";
+    for (int Length = 1; Length <= MaxStreakLength; Length++)
+    {
+        if (Streaks.GetStreaks(Length) > 0)
+        {
+            std::cout << (Length == MaxStreakLength ? "  " + std::to_string(Length) + "+" : "  " + std::to_string(Length))
+                      << ": " << Streaks.GetStreaks(Length) << "\n";
+        }
+    }
+    std::cout << "Longest: " << Streaks.GetLongest() << std::endl;
+    return true;
+}
+
+void CGame::WriteSnapshot(std::ofstream& File, bool Json, const CRunningStats& Stay, const CRunningStats& Switch,
+                          const CStreakHistogram& Streaks)
+{
+    double SwitchMargin = ConfidenceZ * sqrt(Switch.GetVariance() / Switch.GetCount());
+
+    if (!Json)
+    {
+        File << Switch.GetCount() << "," << Stay.GetMean() << "," << Stay.GetVariance() << "," << Switch.GetMean() << ","
+             << Switch.GetVariance() << "," << SwitchMargin << "," << Streaks.GetLongest();
+        for (int Length = 1; Length <= MaxStreakLength; Length++)
+        {
+            File << "," << Streaks.GetStreaks(Length);
+        }
+        File << "\n";
+        return;
+    }
+
+    File << "{\"games\":" << Switch.GetCount() << ",\"stay_mean\":" << Stay.GetMean() << ",\"stay_variance\":" << Stay.GetVariance()
+         << ",\"switch_mean\":" << Switch.GetMean() << ",\"switch_variance\":" << Switch.GetVariance()
+         << ",\"switch_margin\":" << SwitchMargin << ",\"longest_streak\":" << Streaks.GetLongest() << ",\"streaks\":[";
+    for (int Length = 1; Length <= MaxStreakLength; Length++)
+    {
+        File << (Length > 1 ? "," : "") << Streaks.GetStreaks(Length);
+    }
+    File << "]}\n";
+}